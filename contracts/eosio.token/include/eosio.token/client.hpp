@@ -0,0 +1,122 @@
+#pragma once
+
+#include <eosio/action.hpp>
+#include <eosio/asset.hpp>
+#include <eosio/datastream.hpp>
+#include <eosio/name.hpp>
+#include <eosio/varint.hpp>
+
+#include <string_view>
+#include <vector>
+
+namespace eosio { namespace token_client {
+
+   /**
+    * Header-only helpers for contracts which call `eosio.token` inline, e.g. to pay out rewards.
+    *
+    * `eosio::token::transfer_action` packs its arguments through `action_wrapper`, which copies the memo into a
+    * `std::string` and grows a fresh buffer for every action. The helpers below compute the exact payload size
+    * up front and write it in one pass, and `inline_transfers` reuses one buffer for any number of transfers.
+    */
+
+   /// Number of bytes used by the varuint32 encoding of `value`.
+   constexpr size_t varuint_size( uint32_t value ) {
+      size_t size = 1;
+      while( value >>= 7 ) ++size;
+      return size;
+   }
+
+   /// Exact packed size of the `transfer` payload.
+   constexpr size_t transfer_size( std::string_view memo ) {
+      return sizeof(name) * 2 + sizeof(asset) + varuint_size( memo.size() ) + memo.size();
+   }
+
+   /// Exact packed size of the `issue` payload.
+   constexpr size_t issue_size( std::string_view memo ) {
+      return sizeof(name) + sizeof(asset) + varuint_size( memo.size() ) + memo.size();
+   }
+
+   template<typename Stream>
+   void pack_memo( Stream& ds, std::string_view memo ) {
+      ds << unsigned_int( memo.size() );
+      ds.write( memo.data(), memo.size() );
+   }
+
+   template<typename Stream>
+   void pack_transfer( Stream& ds, const name& from, const name& to, const asset& quantity, std::string_view memo ) {
+      ds << from << to << quantity;
+      pack_memo( ds, memo );
+   }
+
+   template<typename Stream>
+   void pack_issue( Stream& ds, const name& to, const asset& quantity, std::string_view memo ) {
+      ds << to << quantity;
+      pack_memo( ds, memo );
+   }
+
+   /// Packs a `transfer` payload into a buffer allocated once at its exact size.
+   inline std::vector<char> pack_transfer( const name& from, const name& to, const asset& quantity, std::string_view memo ) {
+      std::vector<char> data( transfer_size( memo ) );
+      datastream<char*> ds( data.data(), data.size() );
+      pack_transfer( ds, from, to, quantity, memo );
+      return data;
+   }
+
+   /// Packs an `issue` payload into a buffer allocated once at its exact size.
+   inline std::vector<char> pack_issue( const name& to, const asset& quantity, std::string_view memo ) {
+      std::vector<char> data( issue_size( memo ) );
+      datastream<char*> ds( data.data(), data.size() );
+      pack_issue( ds, to, quantity, memo );
+      return data;
+   }
+
+   /**
+    * Sends many inline `transfer` actions from one account through a single reused buffer.
+    *
+    * The serialized action header (contract, action name and authorization) is written once. Every `send` only
+    * rewrites the payload behind it and hands the buffer to `send_inline`, so no allocation happens once the
+    * buffer has grown to fit the longest memo.
+    *
+    * @code
+    * token_client::inline_transfers payouts( "eosio.token"_n, get_self() );
+    * for( const auto& winner : winners )
+    *    payouts.send( winner, prize, "prize" );
+    * @endcode
+    */
+   class inline_transfers {
+      public:
+         inline_transfers( const name& token_contract, const name& from )
+         :inline_transfers( token_contract, from, permission_level{ from, "active"_n } ) {}
+
+         inline_transfers( const name& token_contract, const name& from, const permission_level& auth )
+         :_from( from )
+         {
+            constexpr size_t header_size = sizeof(name) * 2 + 1 /* one authorization */ + sizeof(permission_level);
+            _buffer.resize( header_size + 1 + transfer_size( {} ) );
+
+            datastream<char*> ds( _buffer.data(), _buffer.size() );
+            ds << token_contract << "transfer"_n << unsigned_int( 1 ) << auth;
+            _header_size = ds.tellp();
+         }
+
+         void send( const name& to, const asset& quantity, std::string_view memo ) {
+            const size_t payload_size = transfer_size( memo );
+            const size_t total_size = _header_size + varuint_size( payload_size ) + payload_size;
+            if( _buffer.size() < total_size ) {
+               _buffer.resize( total_size );
+            }
+
+            datastream<char*> ds( _buffer.data() + _header_size, total_size - _header_size );
+            ds << unsigned_int( payload_size );
+            pack_transfer( ds, _from, to, quantity, memo );
+
+            internal_use_do_not_use::send_inline( _buffer.data(), total_size );
+         }
+
+      private:
+         name              _from;
+         size_t            _header_size = 0;
+         std::vector<char> _buffer;
+   };
+
+} } /// namespace eosio::token_client
@@ -1,9 +1,26 @@
 #pragma once
 
 #include <eosio/asset.hpp>
+#include <eosio/crypto.hpp>
 #include <eosio/eosio.hpp>
+#include <eosio/system.hpp>
 
+#include <algorithm>
+#include <array>
+#include <optional>
 #include <string>
+#include <vector>
+
+/**
+ * Defining `EOSIO_TOKEN_HOT_ONLY` builds a contract exposing only `transfer`, `open` and `close`. The other
+ * actions, marked `EOSIO_TOKEN_COLD_ACTION`, administrative or not, become plain member functions which the
+ * linker drops. The build is for benchmarking the size of the contract only and is not meant to be deployed.
+ */
+#ifdef EOSIO_TOKEN_HOT_ONLY
+#define EOSIO_TOKEN_COLD_ACTION
+#else
+#define EOSIO_TOKEN_COLD_ACTION [[eosio::action]]
+#endif
 
 namespace eosiosystem {
    class system_contract;
@@ -13,6 +30,45 @@ namespace eosio {
 
    using std::string;
 
+   /**
+    * Value returned by `transfer` and `xfer`, so that inline callers and off-chain reconcilers learn
+    * the fee charged and the resulting balances without reading the tables again.
+    */
+   struct transfer_result {
+      asset    fee;           // the fee charged for the transfer
+      name     fee_payer;     // `from`, or `to` when the sender is exempted from fees
+      asset    from_balance;  // balance of `from` after the transfer
+      asset    to_balance;    // balance of `to` after the transfer
+   };
+
+   /**
+    * Compressed proof of one leaf of a sparse Merkle tree of balances, as taken by `hibernate` and `restore`.
+    * Bit `d` of `bitmap` is set when the sibling at depth `d` on the path of the owner is not an empty subtree,
+    * and `siblings` holds those non-empty siblings from the root down. Empty siblings are not sent.
+    */
+   struct merkle_proof {
+      uint64_t                  bitmap = 0;
+      std::vector<checksum256>  siblings;
+   };
+
+   /**
+    * One balance returned by the `getbalances` query action.
+    */
+   struct owner_balance {
+      name     owner;
+      asset    balance;
+   };
+
+   /**
+    * The state of one token returned by the `getstats` query action.
+    */
+   struct token_stats {
+      asset    supply;
+      asset    max_supply;
+      name     issuer;
+      uint8_t  fees;
+   };
+
    /**
     * The `eosio.token` sample system contract defines the structures and actions that allow users to create, issue, and manage tokens for EOSIO based blockchains. It demonstrates one way to implement a smart contract which allows for creation and management of tokens. It is possible for one to create a similar contract which suits different needs. However, it is recommended that if one only needs a token with the below listed actions, that one uses the `eosio.token` contract instead of developing their own.
     * 
@@ -37,7 +93,7 @@ namespace eosio {
           * @pre maximum_supply has to be smaller than the maximum supply allowed by the system: 1^62 - 1.
           * @pre Maximum supply must be positive;
           */
-         [[eosio::action]]
+         EOSIO_TOKEN_COLD_ACTION
          void create( const name&   issuer,
                       const asset&  maximum_supply);
          /**
@@ -46,9 +102,11 @@ namespace eosio {
           * @param to - the account to issue tokens to, it must be the same as the issuer,
           * @param quantity - the amount of tokens to be issued,
           * @memo - the memo string that accompanies the token issue transaction.
+          *
+          * @return the supply of the token after the issue.
           */
-         [[eosio::action]]
-         void issue( const name& to, const asset& quantity, const string& memo );
+         EOSIO_TOKEN_COLD_ACTION
+         asset issue( const name& to, const asset& quantity, const string& memo );
 
          /**
           * The opposite for create action, if all validations succeed,
@@ -56,9 +114,11 @@ namespace eosio {
           *
           * @param quantity - the quantity of tokens to retire,
           * @param memo - the memo string to accompany the transaction.
+          *
+          * @return the supply of the token after the retirement.
           */
-         [[eosio::action]]
-         void retire( const asset& quantity, const string& memo );
+         EOSIO_TOKEN_COLD_ACTION
+         asset retire( const asset& quantity, const string& memo );
 
          /**
           * Allows `from` account to transfer to `to` account the `quantity` tokens.
@@ -68,12 +128,119 @@ namespace eosio {
           * @param to - the account to be transferred to,
           * @param quantity - the quantity of tokens to be transferred,
           * @param memo - the memo string to accompany the transaction.
+          *
+          * @return the fee charged, who paid it and the balances of both accounts after the transfer.
           */
          [[eosio::action]]
-         void transfer( const name&    from,
+         transfer_result transfer( const name&    from,
                         const name&    to,
                         const asset&   quantity,
                         const string&  memo );
+
+         /**
+          * Idempotent variant of `transfer` for payout services which retry on timeouts. A transfer whose
+          * `request_id` was already used by `from` within the deduplication window is rejected, so retrying a
+          * transfer which did go through cannot pay twice. Every call also prunes a bounded number of expired
+          * request ids of `from`, which keeps the RAM used for deduplication flat.
+          *
+          * @param from - the account to transfer from,
+          * @param to - the account to be transferred to,
+          * @param quantity - the quantity of tokens to be transferred,
+          * @param memo - the memo string to accompany the transaction,
+          * @param request_id - an identifier of the payout, unique per `from` within the deduplication window.
+          *
+          * @return the same result as `transfer`.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         transfer_result transferid( const name&    from,
+                                     const name&    to,
+                                     const asset&   quantity,
+                                     const string&  memo,
+                                     const uint64_t request_id );
+
+         /**
+          * Compact variant of `transfer` for deposits that carry a numeric tag instead of a memo string.
+          * The precision of the token is taken from its stats, so only the amount and the symbol code
+          * are sent. Validation, fees, balance updates and notifications are the same as for `transfer`.
+          *
+          * @param from - the account to transfer from,
+          * @param to - the account to be transferred to,
+          * @param amount - the amount of tokens to be transferred, in the token's smallest unit,
+          * @param sym - the symbol code of the token to be transferred,
+          * @param tag - a numeric deposit tag, e.g. the customer id at the receiving exchange.
+          *
+          * @return the same result as `transfer`.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         transfer_result xfer( const name&         from,
+                    const name&         to,
+                    const uint64_t      amount,
+                    const symbol_code&  sym,
+                    const uint64_t      tag );
+
+         /**
+          * Allows `a` and `b` to atomically exchange `quantity_a` of one token for `quantity_b` of another,
+          * both managed by this contract. Both legs are settled in a single action and transfer fees are
+          * charged on each leg exactly as `transfer` would charge them.
+          *
+          * @param a - the account sending `quantity_a` and receiving `quantity_b`,
+          * @param b - the account sending `quantity_b` and receiving `quantity_a`,
+          * @param quantity_a - the quantity of tokens sent from `a` to `b`,
+          * @param quantity_b - the quantity of tokens sent from `b` to `a`,
+          * @param memo - the memo string to accompany the swap.
+          *
+          * @pre Both `a` and `b` have to authorize the action,
+          * @pre `quantity_a` and `quantity_b` have to be of different tokens.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void swap( const name&    a,
+                    const name&    b,
+                    const asset&   quantity_a,
+                    const asset&   quantity_b,
+                    const string&  memo );
+
+         /**
+          * Moves `quantity` from the balance of `owner` into its virtual sub-account `subaccount`.
+          * Sub-accounts are an internal ledger controlled by `owner`, e.g. one per exchange customer,
+          * that avoids creating a blockchain account per customer. A sub-account holds a single token,
+          * the first deposit binds it to the token of `quantity`.
+          * Sub-account balances are kept apart from the balance row of `owner`. They are not committed to the
+          * `balances_root` of `enablemerkle`, and the supply of a token is the sum of its balance rows, its
+          * hibernated supply and its sub-account balances. A balance row whose owner holds its token in a
+          * sub-account can neither `hibernate` nor be swept.
+          *
+          * @param owner - the account owning the sub-account,
+          * @param subaccount - the identifier of the sub-account, chosen by `owner`,
+          * @param quantity - the quantity of tokens to deposit.
+          *
+          * @pre `owner` must have a balance of at least `quantity`, and it must not be frozen.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void subdeposit( const name& owner, const uint64_t subaccount, const asset& quantity );
+
+         /**
+          * Moves `quantity` from the virtual sub-account `subaccount` back into the balance of `owner`.
+          * The sub-account row is removed, and its RAM refunded, once its balance reaches zero.
+          *
+          * @param owner - the account owning the sub-account,
+          * @param subaccount - the identifier of the sub-account,
+          * @param quantity - the quantity of tokens to withdraw.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void subwithdraw( const name& owner, const uint64_t subaccount, const asset& quantity );
+
+         /**
+          * Moves `quantity` between two virtual sub-accounts of `owner`. Internal moves never leave the
+          * owner's ledger, so no notifications are sent and no transfer fee is charged.
+          *
+          * @param owner - the account owning both sub-accounts,
+          * @param from - the identifier of the sub-account to debit,
+          * @param to - the identifier of the sub-account to credit,
+          * @param quantity - the quantity of tokens to move.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void submove( const name& owner, const uint64_t from, const uint64_t to, const asset& quantity );
+
          /**
           * Allows `ram_payer` to create an account `owner` with zero balance for
           * token `symbol` at the expense of `ram_payer`.
@@ -88,6 +255,17 @@ namespace eosio {
          [[eosio::action]]
          void open( const name& owner, const symbol& symbol, const name& ram_payer );
 
+         /**
+          * Same as `open` for many owners at once, e.g. to pre-provision the rows of new users. The token and
+          * its precision are checked once, and owners which already have a row are skipped.
+          *
+          * @param owners - the accounts to open a zero balance for,
+          * @param symbol - the token to open the balances of,
+          * @param ram_payer - the account paying for the new rows.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void openbatch( const std::vector<name>& owners, const symbol& symbol, const name& ram_payer );
+
          /**
           * This action is the opposite for open, it closes the account `owner`
           * for token `symbol`.
@@ -111,7 +289,7 @@ namespace eosio {
           *
           * @pre The pair of owner plus symbol has to exist otherwise no action is executed,
           */
-          [[eosio::action]]
+         EOSIO_TOKEN_COLD_ACTION
          void freeze( const name& account, const symbol& symbol, const bool& status );
 
          /**
@@ -124,17 +302,121 @@ namespace eosio {
           *
           * @pre The pair of issuer plus symbol has to exist otherwise no action is executed,
           */
-          [[eosio::action]]
+         EOSIO_TOKEN_COLD_ACTION
          void setfee( const name& issuer, const symbol& symbol, const uint8_t fees );
 
+         /**
+          * Allows the issuer of `symbol` to maintain a sparse Merkle tree commitment of all balances of the token.
+          * Once enabled, every balance change updates the tree and its root is kept in the stats of the token,
+          * so that a bridge or light client can check any balance against the root with an O(log n) proof.
+          * Only balance rows are committed, sub-account balances are not, see `subdeposit`.
+          * The tree is keyed by owner and its nodes live in the `smtnodes` table scoped to the symbol code,
+          * their RAM is paid by the account authorizing the action that adds them, like balance rows.
+          *
+          * @param symbol - the symbol of the token to commit the balances of.
+          *
+          * @pre The token must not have been issued yet, so that the tree starts empty.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void enablemerkle( const symbol& symbol );
+
+         /**
+          * Allows the issuer of a token to offload the dormant balance of `owner` to cold storage. The balance row
+          * is erased, refunding its RAM payer, and the balance is added to the leaf of `owner` in a sparse Merkle
+          * tree whose root and total are kept in the stats of the token. The tree itself lives off chain.
+          *
+          * @param owner - the account whose balance hibernates,
+          * @param hibernated - the balance of `owner` already in cold storage, zero if there is none,
+          * @param proof - the proof of `hibernated` against the current cold root.
+          *
+          * @pre The balance row must not be frozen and must not have sent tokens for at least `dormancy_sec`,
+          * @pre `owner` must not hold the token in a sub-account.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void hibernate( const name& owner, const asset& hibernated, const merkle_proof& proof );
+
+         /**
+          * Brings the whole hibernated balance of `owner` back into its balance row, creating the row if needed.
+          * Anyone can restore a balance, since it only moves tokens of `owner` back to `owner`.
+          *
+          * @param owner - the account whose balance is restored,
+          * @param hibernated - the balance of `owner` in cold storage,
+          * @param ram_payer - the account paying for the balance row if it has to be created,
+          * @param proof - the proof of `hibernated` against the current cold root.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void restore( const name& owner, const asset& hibernated, const name& ram_payer, const merkle_proof& proof );
+
+         /**
+          * Allows `owner` to have its zero `symbol` balance row removed by `sweep`, now or whenever the balance
+          * next drops to zero, or withdraws that permission.
+          *
+          * @param owner - the account whose balance row can be swept,
+          * @param symbol - the symbol code of the token,
+          * @param allow - whether the row can be swept.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void allowsweep( const name& owner, const symbol_code& symbol, const bool allow );
+
+         /**
+          * Allows the issuer of a token to let `sweep` remove zero balance rows which have not sent tokens for
+          * `horizon_sec` seconds, even if their owner did not call `allowsweep`.
+          *
+          * @param symbol - the symbol code of the token,
+          * @param horizon_sec - the inactivity horizon, 0 only sweeps rows whose owner allowed it.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void setsweep( const symbol_code& symbol, const uint32_t horizon_sec );
+
+         /**
+          * Puts the zero `symbol` balance row of `owner` on the list checked by `sweep`, typically by the RAM
+          * payer of the row, which gets the RAM back once the row is swept.
+          *
+          * @param payer - the account paying for the list entry until it is swept,
+          * @param owner - the account whose balance row is nominated,
+          * @param symbol - the symbol code of the token.
+          *
+          * @pre The token must have an inactivity horizon, see `setsweep`.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void nominate( const name& payer, const name& owner, const symbol_code& symbol );
+
+         /**
+          * Removes the listed `symbol` balance rows which are zero, not frozen, whose owner holds no `symbol` in
+          * a sub-account, and either allowed by their owner or past the inactivity horizon of the token. Every removed row refunds its RAM payer. It requires no
+          * authorization, the caller only pays for the CPU.
+          *
+          * @param symbol - the symbol code of the token,
+          * @param cursor - the owner to resume from, 0 to start from the beginning of the list,
+          * @param limit - the maximum number of list entries checked, to stay within the CPU limit.
+          *
+          * @return the cursor for the next call, 0 once the end of the list is reached.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         uint64_t sweep( const symbol_code& symbol, const uint64_t cursor, const uint32_t limit );
+
+         /**
+          * Upgrades the `symbol` balance rows of `owners`, and the stats row of `symbol`, to the current row
+          * version. Rows are otherwise upgraded lazily when they are written, this action lets a sponsor catch up
+          * on rows which are rarely written. Upgraded balance rows are billed to `payer`, which refunds their
+          * previous RAM payer.
+          *
+          * @param payer - the account sponsoring the RAM of the upgraded balance rows,
+          * @param symbol - the symbol of the token to upgrade the rows of,
+          * @param owners - the batch of owners to upgrade, rows already at the current version are skipped.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void migrate( const name& payer, const symbol_code& symbol, const std::vector<name>& owners );
+
          /**
           * This is no-op action to keep track of fee for transfers.
+          * It is kept for ABI compatibility only, fees are reported in the return value of `transfer`.
           *
           * @param account - wallet who paid the fees
           * @param fee - amount of fees paid for transfer
           *
           */
-         [[eosio::action]]
+         EOSIO_TOKEN_COLD_ACTION
          void logfee( const name& account, const asset& fees);
 
 
@@ -154,9 +436,44 @@ namespace eosio {
          *                      toggled. It's added to or removed from the exemption 
          *                      list based on its current status.
          */
-          [[eosio::action]]
+         EOSIO_TOKEN_COLD_ACTION
          void switchexempt(const name& issuer, const symbol& symbol, const name& account);
 
+         /**
+          * Allows `account` to stop receiving notifications of the transfers it sends or receives, which saves
+          * the dispatch and the action traces of accounts without code. Accounts are notified by default.
+          *
+          * @param account - the account changing its notification setting,
+          * @param notify - whether `account` is notified of its transfers.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         void setnotify( const name& account, const bool notify );
+
+         /**
+          * Query action returning the balances of every owner in `owners` for every token in `sym_codes`,
+          * so that a whole portfolio is answered by one dry-run or trace instead of one table read per pair.
+          * It requires no authorization and does not modify any state.
+          *
+          * @param owners - the accounts to read the balances of,
+          * @param sym_codes - the symbol codes of the tokens to read.
+          *
+          * @return one entry per existing balance row, ordered by owner then by symbol code as given.
+          *         Pairs without a balance row are omitted.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         std::vector<owner_balance> getbalances( const std::vector<name>& owners, const std::vector<symbol_code>& sym_codes );
+
+         /**
+          * Query action returning the supply, maximum supply, issuer and fee of every token in `sym_codes`.
+          * It requires no authorization and does not modify any state.
+          *
+          * @param sym_codes - the symbol codes of the tokens to read.
+          *
+          * @return one entry per existing token, in the order given. Unknown symbol codes are omitted.
+          */
+         EOSIO_TOKEN_COLD_ACTION
+         std::vector<token_stats> getstats( const std::vector<symbol_code>& sym_codes );
+
 
          static asset get_supply( const name& token_contract_account, const symbol_code& sym_code )
          {
@@ -165,6 +482,11 @@ namespace eosio {
             return st.supply;
          }
 
+         /**
+          * Balance held in the balance row of `owner`. A hibernated balance has no row until it is restored,
+          * so it is not included, and the call aborts if `owner` has no row at all.
+          * Hibernated balances are committed to the cold root in the stats of the token, see `hibernate`.
+          */
          static asset get_balance( const name& token_contract_account, const name& owner, const symbol_code& sym_code )
          {
             accounts accountstable( token_contract_account, owner.value );
@@ -172,23 +494,114 @@ namespace eosio {
             return ac.balance;
          }
 
+         /**
+          * Non-throwing variant of `get_supply`, returns an empty optional if the token does not exist.
+          * The row is read directly and only its leading `supply` field is decoded.
+          */
+         static std::optional<asset> try_get_supply( const name& token_contract_account, const symbol_code& sym_code )
+         {
+            return read_asset( token_contract_account, sym_code.raw(), "stat"_n, sym_code );
+         }
+
+         /**
+          * Non-throwing variant of `get_balance`, returns an empty optional if `owner` has no balance row.
+          * The row is read directly and only its leading `balance` field is decoded.
+          */
+         static std::optional<asset> try_get_balance( const name& token_contract_account, const name& owner, const symbol_code& sym_code )
+         {
+            return read_asset( token_contract_account, owner.value, "accounts"_n, sym_code );
+         }
+
+         /**
+          * Reads the balances of many `owners` for one token, in the same order as `owners`.
+          * Owners without a balance row get an empty optional instead of aborting the transaction.
+          */
+         static std::vector<std::optional<asset>> get_balances( const name& token_contract_account, const std::vector<name>& owners, const symbol_code& sym_code )
+         {
+            std::vector<std::optional<asset>> balances;
+            balances.reserve( owners.size() );
+            for( const auto& owner : owners ) {
+               balances.push_back( read_asset( token_contract_account, owner.value, "accounts"_n, sym_code ) );
+            }
+            return balances;
+         }
+
+         /**
+          * Raw read of the balance amount of `owner`, in the token's smallest unit, for callers which already
+          * know the symbol. Only the leading 8 bytes of the row are copied. Returns 0 if there is no balance row.
+          */
+         static int64_t get_balance_amount( const name& token_contract_account, const name& owner, const symbol_code& sym_code )
+         {
+            const auto itr = internal_use_do_not_use::db_find_i64( token_contract_account.value, owner.value, "accounts"_n.value, sym_code.raw() );
+            if( itr < 0 ) return 0;
+
+            int64_t amount = 0;
+            internal_use_do_not_use::db_get_i64( itr, &amount, sizeof(amount) );
+            return amount;
+         }
+
 
          // Actions open to public
          using create_action = eosio::action_wrapper<"create"_n, &token::create>;
          using issue_action = eosio::action_wrapper<"issue"_n, &token::issue>;
          using retire_action = eosio::action_wrapper<"retire"_n, &token::retire>;
          using transfer_action = eosio::action_wrapper<"transfer"_n, &token::transfer>;
+         using transferid_action = eosio::action_wrapper<"transferid"_n, &token::transferid>;
+         using xfer_action = eosio::action_wrapper<"xfer"_n, &token::xfer>;
+         using swap_action = eosio::action_wrapper<"swap"_n, &token::swap>;
+         using subdeposit_action = eosio::action_wrapper<"subdeposit"_n, &token::subdeposit>;
+         using subwithdraw_action = eosio::action_wrapper<"subwithdraw"_n, &token::subwithdraw>;
+         using submove_action = eosio::action_wrapper<"submove"_n, &token::submove>;
          using open_action = eosio::action_wrapper<"open"_n, &token::open>;
+         using openbatch_action = eosio::action_wrapper<"openbatch"_n, &token::openbatch>;
          using close_action = eosio::action_wrapper<"close"_n, &token::close>;
          using freeze_action = eosio::action_wrapper<"freeze"_n, &token::freeze>;
          using setfee_action = eosio::action_wrapper<"setfee"_n, &token::setfee>;
          using switchexempt_action = eosio::action_wrapper<"switchexempt"_n, &token::switchexempt>;
+         using setnotify_action = eosio::action_wrapper<"setnotify"_n, &token::setnotify>;
+         using getbalances_action = eosio::action_wrapper<"getbalances"_n, &token::getbalances>;
+         using getstats_action = eosio::action_wrapper<"getstats"_n, &token::getstats>;
+         using enablemerkle_action = eosio::action_wrapper<"enablemerkle"_n, &token::enablemerkle>;
+         using hibernate_action = eosio::action_wrapper<"hibernate"_n, &token::hibernate>;
+         using restore_action = eosio::action_wrapper<"restore"_n, &token::restore>;
+         using allowsweep_action = eosio::action_wrapper<"allowsweep"_n, &token::allowsweep>;
+         using setsweep_action = eosio::action_wrapper<"setsweep"_n, &token::setsweep>;
+         using nominate_action = eosio::action_wrapper<"nominate"_n, &token::nominate>;
+         using sweep_action = eosio::action_wrapper<"sweep"_n, &token::sweep>;
+         using migrate_action = eosio::action_wrapper<"migrate"_n, &token::migrate>;
          using logfee_action = eosio::action_wrapper<"logfee"_n, &token::logfee>;
 
       private:
+         // `balance` and `supply` are the leading fields of their rows, so an asset can be read without decoding the rest
+         static std::optional<asset> read_asset( const name& code, uint64_t scope, const name& table, const symbol_code& sym_code )
+         {
+            const auto itr = internal_use_do_not_use::db_find_i64( code.value, scope, table.value, sym_code.raw() );
+            if( itr < 0 ) return std::nullopt;
+
+            uint64_t raw[2];
+            internal_use_do_not_use::db_get_i64( itr, raw, sizeof(raw) );
+
+            asset result;
+            result.amount = static_cast<int64_t>( raw[0] );
+            result.symbol = symbol{ raw[1] };
+            return result;
+         }
+
+         /**
+          * Rows are versioned so that fields can be appended without a migration pass over every row.
+          * Fields added after version 0 are `binary_extension`s, so a row of any version decodes and rows
+          * are only rewritten in the current layout when they are written anyway, see `upgrade`.
+          */
+         static constexpr uint8_t account_version = 2;
+         static constexpr uint8_t stats_version   = 4;
+
+         static constexpr uint8_t stats_flag_merkle = 0x01; // balances are committed to `balances_root`
+
          struct [[eosio::table]] account {
             asset    balance;
             bool     is_frozen = false;
+            binary_extension<uint8_t>  version; // absent on version 0 rows
+            binary_extension<time_point_sec>  last_active; // since version 2, last time the owner sent tokens
 
             uint64_t primary_key()const { return balance.symbol.code().raw(); }
          };
@@ -200,6 +613,13 @@ namespace eosio {
             asset    max_supply;
             name     issuer;
             uint8_t  fees=10;
+            binary_extension<uint8_t>  version; // absent on version 0 rows
+            binary_extension<uint8_t>  flags;   // since version 2
+            binary_extension<checksum256>  balances_root; // since version 2, see `enablemerkle`
+            binary_extension<time_point_sec>  active_since; // since version 3, rows without `last_active` are this old
+            binary_extension<checksum256>  hibernated_root; // since version 3, see `hibernate`
+            binary_extension<asset>  hibernated_supply; // since version 3
+            binary_extension<uint32_t>  sweep_horizon_sec; // since version 4, see `setsweep`
 
             uint64_t primary_key()const { return supply.symbol.code().raw(); }
          };
@@ -213,10 +633,127 @@ namespace eosio {
          };
          typedef eosio::multi_index<"exemptedacc"_n, exemptedaccount> exemptions_table;
 
+         // Accounts which are not notified of their transfers, see `setnotify`
+         struct [[eosio::table]] notify_optout {
+            name account;
+
+            uint64_t primary_key()const { return account.value; }
+         };
+         typedef eosio::multi_index< "optouts"_n, notify_optout > notify_optouts;
+
+         // Virtual sub-account balances, scoped to the owning account and indexed by token
+         struct [[eosio::table]] subaccount {
+            uint64_t id;
+            asset    balance;
+
+            uint64_t primary_key()const { return id; }
+            uint64_t by_symbol()const { return balance.symbol.code().raw(); }
+         };
+         typedef eosio::multi_index< "subaccounts"_n, subaccount,
+                                     indexed_by< "bysymbol"_n, const_mem_fun<subaccount, uint64_t, &subaccount::by_symbol> >
+                                   > subaccounts;
+
+
+         // Brings a row read in any version to the current layout, filling in defaults for the fields it lacks
+         static void upgrade( account& a ) {
+            // a row written before activity was recorded counts as last active at the `active_since` of its token
+            if( !a.last_active.has_value() ) a.last_active.emplace();
+            a.version.emplace( account_version );
+         }
+
+         static void upgrade( currency_stats& s ) {
+            if( !s.flags.has_value() ) s.flags.emplace( 0 );
+            if( !s.balances_root.has_value() ) s.balances_root.emplace();
+            if( !s.active_since.has_value() ) s.active_since.emplace( current_time_point() );
+            if( !s.hibernated_root.has_value() ) s.hibernated_root.emplace();
+            if( !s.hibernated_supply.has_value() ) s.hibernated_supply.emplace( 0, s.supply.symbol );
+            if( !s.sweep_horizon_sec.has_value() ) s.sweep_horizon_sec.emplace( 0 );
+            s.version.emplace( stats_version );
+         }
+
+         // Balances which have not sent tokens for this long can be moved to cold storage by `hibernate`
+         static constexpr uint32_t dormancy_sec = 365 * 24 * 3600;
+
+         // Last time the owner of `a` sent tokens
+         static time_point_sec last_active( const account& a, const currency_stats& st ) {
+            // a token whose stats predate activity tracking has just started tracking it
+            const time_point_sec active_since = st.active_since.has_value() ? st.active_since.value()
+                                                                            : time_point_sec( current_time_point() );
+            return std::max( a.last_active.value_or( time_point_sec() ), active_since );
+         }
+
+         // Balance rows checked by `sweep`, scoped to the symbol code
+         struct [[eosio::table]] sweep_candidate {
+            name  owner;
+            bool  allowed = false; // by the owner, otherwise nominated for inactivity
+
+            uint64_t primary_key()const { return owner.value; }
+         };
+         typedef eosio::multi_index< "sweepcands"_n, sweep_candidate > sweep_candidates;
+
+         // Request ids used by `transferid`, scoped to the sender and pruned in expiry order
+         static constexpr uint32_t transfer_id_window_sec = 24 * 3600;
+         static constexpr uint32_t max_pruned_transfer_ids = 4;
+
+         struct [[eosio::table]] transfer_id {
+            uint64_t        id;
+            time_point_sec  expires;
+
+            uint64_t primary_key()const { return id; }
+            uint64_t by_expiry()const { return expires.sec_since_epoch(); }
+         };
+         typedef eosio::multi_index< "transferids"_n, transfer_id,
+                                     indexed_by< "byexpiry"_n, const_mem_fun<transfer_id, uint64_t, &transfer_id::by_expiry> >
+                                   > transfer_ids;
+
+         // Inner node of the sparse Merkle tree of balances, scoped to the symbol code. A child is empty, an inner
+         // node below, or the leaf of the single holder under it, whose owner is then kept next to its hash. Leaves
+         // sit at the first depth where the path of their owner parts from every other holder's, so the depth of
+         // the tree follows the number of holders. An empty subtree hashes to all zeros.
+         struct [[eosio::table]] merkle_node {
+            uint64_t     key;
+            checksum256  left;
+            checksum256  right;
+            name         left_owner;   // set when `left` is a leaf
+            name         right_owner;  // set when `right` is a leaf
+
+            uint64_t primary_key()const { return key; }
+
+            const checksum256& child( bool is_right )const { return is_right ? right : left; }
+            const name& child_owner( bool is_right )const { return is_right ? right_owner : left_owner; }
+            void set_child( bool is_right, const checksum256& hash, const name& leaf_owner ) {
+               ( is_right ? right : left ) = hash;
+               ( is_right ? right_owner : left_owner ) = leaf_owner;
+            }
+         };
+         typedef eosio::multi_index< "smtnodes"_n, merkle_node > merkle_nodes;
+
+         // The `depth` leading bits of `path` followed by a sentinel bit, which makes the key unique per depth
+         static uint64_t merkle_node_key( uint64_t path, int depth ) {
+            const uint64_t prefix = depth == 0 ? 0 : path & ( ~uint64_t(0) << ( 64 - depth ) );
+            return prefix | ( uint64_t(1) << ( 63 - depth ) );
+         }
 
-         void sub_balance( const name& owner, const asset& value );
-         void add_balance( const name& owner, const asset& value, const name& ram_payer );
+         static checksum256 merkle_leaf( const name& owner, const asset& balance );
+         static checksum256 merkle_parent( const checksum256& left, const checksum256& right );
+         checksum256 merkle_update( const symbol_code& sym, const name& owner, const asset& balance, const name& payer );
+         static checksum256 merkle_root( const name& owner, const asset& balance, const merkle_proof& proof );
+         void commit_balances( stats& statstable, const currency_stats& st, const name& payer,
+                               std::initializer_list<std::pair<name, asset>> balances );
+
+         asset sub_balance( const name& owner, const asset& value );
+         asset add_balance( const name& owner, const asset& value, const name& ram_payer );
+         void sub_subaccount( const name& owner, const uint64_t id, const asset& value );
+         void add_subaccount( const name& owner, const uint64_t id, const asset& value );
+         bool has_subaccount_funds( const name& owner, const symbol_code& sym );
          asset compute_fee(const asset& quantity, uint8_t fee);
+         void check_transfer_parties( const name& from, const name& to );
+         void notify( const name& account );
+         void check_transfer_quantity( const asset& quantity, const currency_stats& st );
+         transfer_result do_transfer( const name& from, const name& to, const asset& quantity,
+                                      stats& statstable, const currency_stats& st );
+         transfer_result settle( const name& from, const name& to, const asset& quantity,
+                                 stats& statstable, const currency_stats& st, const name& ram_payer );
 
    };
 
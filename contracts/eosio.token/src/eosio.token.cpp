@@ -18,6 +18,7 @@ void token::create( const name& issuer, const asset& maximum_supply ) {
        s.supply.symbol = maximum_supply.symbol;
        s.max_supply    = maximum_supply;
        s.issuer        = issuer;
+       upgrade( s );
     });
 }
 
@@ -34,11 +35,12 @@ void token::setfee( const name& issuer, const symbol& symbol, const uint8_t fees
 
     statstable.modify(existing, same_payer, [&]( auto& s ) {
        s.fees = fees;
+       upgrade( s );
     });
 }
 
 
-void token::issue( const name& to, const asset& quantity, const string& memo )
+asset token::issue( const name& to, const asset& quantity, const string& memo )
 {
     auto sym = quantity.symbol;
     check( sym.is_valid(), "invalid symbol name" );
@@ -59,12 +61,16 @@ void token::issue( const name& to, const asset& quantity, const string& memo )
 
     statstable.modify( st, same_payer, [&]( auto& s ) {
        s.supply += quantity;
+       upgrade( s );
     });
 
-    add_balance( st.issuer, quantity, st.issuer );
+    const auto balance = add_balance( st.issuer, quantity, st.issuer );
+    commit_balances( statstable, st, st.issuer, { { st.issuer, balance } } );
+
+    return st.supply;
 }
 
-void token::retire( const asset& quantity, const string& memo )
+asset token::retire( const asset& quantity, const string& memo )
 {
     auto sym = quantity.symbol;
     check( sym.is_valid(), "invalid symbol name" );
@@ -83,84 +89,626 @@ void token::retire( const asset& quantity, const string& memo )
 
     statstable.modify( st, same_payer, [&]( auto& s ) {
        s.supply -= quantity;
+       upgrade( s );
     });
 
-    sub_balance( st.issuer, quantity );
+    const auto balance = sub_balance( st.issuer, quantity );
+    commit_balances( statstable, st, st.issuer, { { st.issuer, balance } } );
+
+    return st.supply;
 }
 
-void token::transfer( const name&    from,
-                      const name&    to,
-                      const asset&   quantity,
-                      const string&  memo )
+transfer_result token::transfer( const name&    from,
+                                 const name&    to,
+                                 const asset&   quantity,
+                                 const string&  memo )
 {
-    check( from != to, "cannot transfer to self" );
-    require_auth( from );
-    check( is_account( to ), "to account does not exist");
+    check_transfer_parties( from, to );
 
    // Ensure symbol is valid
     auto sym = quantity.symbol.code();
     stats statstable( get_self(), sym.raw() );
     const auto& st = statstable.get( sym.raw(), "no balance with specified symbol" );
 
-    require_recipient( from );
-    require_recipient( to );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    return do_transfer( from, to, quantity, statstable, st );
+}
+
+transfer_result token::transferid( const name&    from,
+                                   const name&    to,
+                                   const asset&   quantity,
+                                   const string&  memo,
+                                   const uint64_t request_id )
+{
+    require_auth( from );
+
+    const time_point_sec now{ current_time_point() };
+    transfer_ids ids( get_self(), from.value );
+
+    // a bounded amount of pruning per call, each call adds at most one id so the table cannot grow unbounded
+    auto by_expiry = ids.get_index<"byexpiry"_n>();
+    uint32_t pruned = 0;
+    for( auto it = by_expiry.begin(); it != by_expiry.end() && it->expires <= now && pruned < max_pruned_transfer_ids; ++pruned ) {
+        it = by_expiry.erase( it );
+    }
+
+    const time_point_sec expires = now + transfer_id_window_sec;
+    auto existing = ids.find( request_id );
+    if( existing == ids.end() ) {
+        ids.emplace( from, [&]( auto& t ) {
+            t.id      = request_id;
+            t.expires = expires;
+        });
+    } else {
+        check( existing->expires <= now, "duplicate transfer request id" );
+        ids.modify( existing, from, [&]( auto& t ) {
+            t.expires = expires;
+        });
+    }
+
+    return transfer( from, to, quantity, memo );
+}
+
+transfer_result token::xfer( const name&         from,
+                             const name&         to,
+                             const uint64_t      amount,
+                             const symbol_code&  sym,
+                             const uint64_t      tag )
+{
+    check_transfer_parties( from, to );
+
+    stats statstable( get_self(), sym.raw() );
+    const auto& st = statstable.get( sym.raw(), "no balance with specified symbol" );
+
+    // precision is implied by the token, amounts above 2^62 are rejected as an invalid quantity
+    const asset quantity{ static_cast<int64_t>( amount ), st.supply.symbol };
 
+    return do_transfer( from, to, quantity, statstable, st );
+}
+
+void token::check_transfer_parties( const name& from, const name& to ) {
+    check( from != to, "cannot transfer to self" );
+    require_auth( from );
+    check( is_account( to ), "to account does not exist");
+}
+
+void token::notify( const name& account ) {
+    notify_optouts optouts( get_self(), get_self().value );
+    if( optouts.find( account.value ) == optouts.end() ) {
+       require_recipient( account );
+    }
+}
+
+transfer_result token::do_transfer( const name& from, const name& to, const asset& quantity,
+                                    stats& statstable, const currency_stats& st )
+{
+    notify( from );
+    notify( to );
+
+    check_transfer_quantity( quantity, st );
+
+    auto payer = has_auth( to ) ? to : from;
+
+    return settle( from, to, quantity, statstable, st, payer );
+}
+
+void token::swap( const name&    a,
+                  const name&    b,
+                  const asset&   quantity_a,
+                  const asset&   quantity_b,
+                  const string&  memo )
+{
+    check( a != b, "cannot swap with self" );
+    require_auth( a );
+    require_auth( b );
+
+    auto sym_a = quantity_a.symbol.code();
+    auto sym_b = quantity_b.symbol.code();
+    check( sym_a != sym_b, "cannot swap a token for itself" );
+
+    stats stats_a( get_self(), sym_a.raw() );
+    const auto& st_a = stats_a.get( sym_a.raw(), "no balance with specified symbol" );
+    stats stats_b( get_self(), sym_b.raw() );
+    const auto& st_b = stats_b.get( sym_b.raw(), "no balance with specified symbol" );
+
+    notify( a );
+    notify( b );
+
+    check_transfer_quantity( quantity_a, st_a );
+    check_transfer_quantity( quantity_b, st_b );
+    check( memo.size() <= 256, "memo has more than 256 bytes" );
+
+    // both parties authorized, so each one pays for the balance rows it receives
+    settle( a, b, quantity_a, stats_a, st_a, b );
+    settle( b, a, quantity_b, stats_b, st_b, a );
+}
+
+void token::check_transfer_quantity( const asset& quantity, const currency_stats& st ) {
     check( quantity.is_valid(), "invalid quantity" );
     check( quantity.amount > 0, "must transfer positive quantity" );
     check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    check( memo.size() <= 256, "memo has more than 256 bytes" );
-
-    auto payer = has_auth( to ) ? to : from;
+}
 
+transfer_result token::settle( const name& from, const name& to, const asset& quantity,
+                               stats& statstable, const currency_stats& st, const name& ram_payer )
+{
     asset fee = compute_fee(quantity, st.fees);
 
     exemptions_table exempts(get_self(), quantity.symbol.code().raw());
     bool is_exempted = exempts.find(from.value) != exempts.end();
 
-
+    transfer_result result{ fee, is_exempted ? to : from };
     if(is_exempted) {
-      sub_balance( from, quantity );
-      add_balance( to, quantity - fee, payer );
-      logfee(to, fee);
+      result.from_balance = sub_balance( from, quantity );
+      result.to_balance   = add_balance( to, quantity - fee, ram_payer );
+    } else {
+      result.from_balance = sub_balance( from, quantity + fee );
+      result.to_balance   = add_balance( to, quantity, ram_payer );
+    }
+
+    // the issuer collects the fee, which also moves its balance when it is a party to the transfer
+    const auto issuer_balance = add_balance( st.issuer, fee, ram_payer );
+    if( st.issuer == from ) result.from_balance = issuer_balance;
+    if( st.issuer == to )   result.to_balance   = issuer_balance;
+
+    if( st.issuer == from || st.issuer == to ) {
+      commit_balances( statstable, st, ram_payer, { { from, result.from_balance }, { to, result.to_balance } } );
     } else {
-      sub_balance( from, quantity + fee );
-      add_balance( to, quantity, payer );
-      logfee(from, fee);
+      commit_balances( statstable, st, ram_payer, { { from, result.from_balance }, { to, result.to_balance }, { st.issuer, issuer_balance } } );
     }
-    add_balance( st.issuer, fee, payer );
+
+    return result;
+}
+
+void token::migrate( const name& payer, const symbol_code& symbol, const std::vector<name>& owners ) {
+   require_auth( payer );
+
+   stats statstable( get_self(), symbol.raw() );
+   const auto& st = statstable.get( symbol.raw(), "symbol does not exist" );
+   if( st.version.value_or( 0 ) < stats_version ) {
+      statstable.modify( st, same_payer, [&]( auto& s ) {
+         upgrade( s );
+      });
+   }
+
+   for( const auto& owner : owners ) {
+      accounts acnts( get_self(), owner.value );
+      auto it = acnts.find( symbol.raw() );
+      if( it == acnts.end() || it->version.value_or( 0 ) >= account_version ) continue;
+
+      acnts.modify( it, payer, [&]( auto& a ) {
+         upgrade( a );
+      });
+   }
+}
+
+void token::enablemerkle( const symbol& symbol ) {
+   stats statstable( get_self(), symbol.code().raw() );
+   const auto& st = statstable.get( symbol.code().raw(), "token with symbol does not exist" );
+
+   require_auth( st.issuer );
+   check( st.supply.symbol == symbol, "symbol precision mismatch" );
+   // with no supply every balance is zero, so the empty tree commits to all of them
+   check( st.supply.amount == 0, "balance commitments can only be enabled before tokens are issued" );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      upgrade( s );
+      s.flags.value() |= stats_flag_merkle;
+      s.balances_root.emplace();
+   });
+}
+
+void token::commit_balances( stats& statstable, const currency_stats& st, const name& payer,
+                             std::initializer_list<std::pair<name, asset>> balances )
+{
+   if( !( st.flags.value_or( 0 ) & stats_flag_merkle ) ) return;
+
+   checksum256 root;
+   for( const auto& [owner, balance] : balances ) {
+      root = merkle_update( st.supply.symbol.code(), owner, balance, payer );
+   }
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.balances_root.emplace( root );
+   });
+}
+
+checksum256 token::merkle_leaf( const name& owner, const asset& balance ) {
+   if( balance.amount == 0 ) return checksum256();
+
+   uint64_t data[2] = { owner.value, static_cast<uint64_t>( balance.amount ) };
+   return sha256( reinterpret_cast<const char*>( data ), sizeof(data) );
+}
+
+checksum256 token::merkle_parent( const checksum256& left, const checksum256& right ) {
+   const checksum256 empty;
+   if( left == empty && right == empty ) return empty;
+
+   const auto l = left.extract_as_byte_array();
+   const auto r = right.extract_as_byte_array();
+   std::array<uint8_t, 64> data;
+   std::copy( l.begin(), l.end(), data.begin() );
+   std::copy( r.begin(), r.end(), data.begin() + 32 );
+   return sha256( reinterpret_cast<const char*>( data.data() ), data.size() );
+}
+
+checksum256 token::merkle_update( const symbol_code& sym, const name& owner, const asset& balance, const name& payer ) {
+   merkle_nodes nodes( get_self(), sym.raw() );
+   const checksum256 empty;
+   const checksum256 leaf = merkle_leaf( owner, balance );
+   // bit `63 - depth` of an owner selects the child at `depth`
+   const auto goes_right = []( const name& account, int depth ) { return ( ( account.value >> ( 63 - depth ) ) & 1 ) != 0; };
+
+   // inner nodes on the path of `owner` from the root down to the one holding its leaf, or the place for it
+   std::vector<merkle_nodes::const_iterator> path;
+   for( auto it = nodes.find( merkle_node_key( owner.value, 0 ) ); it != nodes.end(); ) {
+      path.push_back( it );
+      const int depth = path.size() - 1;
+      const bool is_right = goes_right( owner, depth );
+      if( it->child( is_right ) == empty || it->child_owner( is_right ) != name() ) break;
+      it = nodes.find( merkle_node_key( owner.value, depth + 1 ) );
+      check( it != nodes.end(), "merkle tree is missing a node" );
+   }
+
+   if( path.empty() ) {
+      if( leaf == empty ) return empty;
+      // the root is an inner node even with a single holder
+      const auto root = nodes.emplace( payer, [&]( auto& n ) {
+         n.key = merkle_node_key( owner.value, 0 );
+         n.set_child( goes_right( owner, 0 ), leaf, owner );
+      });
+      return merkle_parent( root->left, root->right );
+   }
+
+   int depth = path.size() - 1;
+   const bool is_right = goes_right( owner, depth );
+   const checksum256 child = path.back()->child( is_right );
+   const name child_owner = path.back()->child_owner( is_right );
+
+   if( child == empty || child_owner == owner ) {
+      if( child == leaf ) return merkle_parent( path.front()->left, path.front()->right );
+      nodes.modify( path.back(), same_payer, [&]( auto& n ) {
+         n.set_child( is_right, leaf, leaf == empty ? name() : owner );
+      });
+   } else {
+      // the place holds the leaf of another holder, which a zero balance leaves where it is
+      if( leaf == empty ) return merkle_parent( path.front()->left, path.front()->right );
+
+      // both leaves move down to the first depth where their paths part, with a chain of nodes above it
+      int split = depth + 1;
+      while( goes_right( owner, split ) == goes_right( child_owner, split ) ) ++split;
+      checksum256 hash;
+      for( int d = split; d > depth; --d ) {
+         const auto it = nodes.emplace( payer, [&]( auto& n ) {
+            n.key = merkle_node_key( owner.value, d );
+            if( d == split ) {
+               n.set_child( goes_right( owner, d ), leaf, owner );
+               n.set_child( goes_right( child_owner, d ), child, child_owner );
+            } else {
+               n.set_child( goes_right( owner, d ), hash, name() );
+            }
+         });
+         hash = merkle_parent( it->left, it->right );
+      }
+      nodes.modify( path.back(), same_payer, [&]( auto& n ) {
+         n.set_child( is_right, hash, name() );
+      });
+   }
+
+   // below the root, a node left with a single leaf hands it up to its parent
+   while( depth > 0 ) {
+      const auto& n = *path.back();
+      if( n.left != empty && n.right != empty ) break;
+      const bool lone_right = n.left == empty;
+      const name lone_owner = n.child_owner( lone_right );
+      if( lone_owner == name() ) break;
+      const checksum256 lone = n.child( lone_right );
+
+      nodes.erase( path.back() );
+      path.pop_back();
+      --depth;
+      nodes.modify( path.back(), same_payer, [&]( auto& p ) {
+         p.set_child( goes_right( owner, depth ), lone, lone_owner );
+      });
+   }
+   if( depth == 0 && path.front()->left == empty && path.front()->right == empty ) {
+      nodes.erase( path.front() );
+      return empty;
+   }
+
+   checksum256 hash = merkle_parent( path.back()->left, path.back()->right );
+   for( int d = depth - 1; d >= 0; --d ) {
+      nodes.modify( path[d], same_payer, [&]( auto& n ) {
+         n.set_child( goes_right( owner, d ), hash, name() );
+      });
+      hash = merkle_parent( path[d]->left, path[d]->right );
+   }
+   return hash;
+}
+
+void token::hibernate( const name& owner, const asset& hibernated, const merkle_proof& proof ) {
+   const auto sym_code_raw = hibernated.symbol.code().raw();
+   stats statstable( get_self(), sym_code_raw );
+   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
+
+   require_auth( st.issuer );
+   check( hibernated.symbol == st.supply.symbol, "symbol precision mismatch" );
+   check( hibernated.amount >= 0, "hibernated balance cannot be negative" );
+
+   accounts acnts( get_self(), owner.value );
+   const auto& acc = acnts.get( sym_code_raw, "no balance object found" );
+   check( !acc.is_frozen, "frozen balances cannot hibernate" );
+   // sub-account funds are outside of both the balance row and the cold tree
+   check( !has_subaccount_funds( owner, hibernated.symbol.code() ), "balances with sub-account funds cannot hibernate" );
+
+   check( time_point_sec( current_time_point() ) >= last_active( acc, st ) + dormancy_sec, "balance is not dormant" );
+
+   check( merkle_root( owner, hibernated, proof ) == st.hibernated_root.value_or( checksum256() ),
+          "invalid proof of the hibernated balance" );
+   const asset balance = acc.balance;
+   const auto root = merkle_root( owner, hibernated + balance, proof );
+
+   acnts.erase( acc );
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      upgrade( s );
+      s.hibernated_root.emplace( root );
+      s.hibernated_supply.value() += balance;
+   });
+   commit_balances( statstable, st, st.issuer, { { owner, asset( 0, balance.symbol ) } } );
+}
+
+void token::restore( const name& owner, const asset& hibernated, const name& ram_payer, const merkle_proof& proof ) {
+   require_auth( ram_payer );
+
+   const auto sym_code_raw = hibernated.symbol.code().raw();
+   stats statstable( get_self(), sym_code_raw );
+   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
+   check( hibernated.symbol == st.supply.symbol, "symbol precision mismatch" );
+   check( hibernated.amount > 0, "nothing to restore" );
+
+   check( merkle_root( owner, hibernated, proof ) == st.hibernated_root.value_or( checksum256() ),
+          "invalid proof of the hibernated balance" );
+   const auto root = merkle_root( owner, asset( 0, hibernated.symbol ), proof );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      upgrade( s );
+      s.hibernated_root.emplace( root );
+      s.hibernated_supply.value() -= hibernated;
+   });
+   const auto balance = add_balance( owner, hibernated, ram_payer );
+   commit_balances( statstable, st, ram_payer, { { owner, balance } } );
+}
+
+void token::allowsweep( const name& owner, const symbol_code& symbol, const bool allow ) {
+   require_auth( owner );
+
+   accounts acnts( get_self(), owner.value );
+   acnts.get( symbol.raw(), "no balance object found" );
+
+   sweep_candidates candidates( get_self(), symbol.raw() );
+   auto it = candidates.find( owner.value );
+   if( !allow ) {
+      check( it != candidates.end() && it->allowed, "sweeping is not allowed for this balance" );
+      candidates.erase( it );
+   } else if( it == candidates.end() ) {
+      candidates.emplace( owner, [&]( auto& c ) {
+         c.owner   = owner;
+         c.allowed = true;
+      });
+   } else {
+      // a nomination becomes the owner's own entry
+      candidates.modify( it, owner, [&]( auto& c ) {
+         c.allowed = true;
+      });
+   }
+}
+
+void token::setsweep( const symbol_code& symbol, const uint32_t horizon_sec ) {
+   stats statstable( get_self(), symbol.raw() );
+   const auto& st = statstable.get( symbol.raw(), "symbol does not exist" );
+   require_auth( st.issuer );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      upgrade( s );
+      s.sweep_horizon_sec.emplace( horizon_sec );
+   });
+}
+
+void token::nominate( const name& payer, const name& owner, const symbol_code& symbol ) {
+   require_auth( payer );
+
+   stats statstable( get_self(), symbol.raw() );
+   const auto& st = statstable.get( symbol.raw(), "symbol does not exist" );
+   check( st.sweep_horizon_sec.value_or( 0 ) > 0, "sweeping inactive balances is not enabled for this token" );
+
+   accounts acnts( get_self(), owner.value );
+   const auto& acc = acnts.get( symbol.raw(), "no balance object found" );
+   check( acc.balance.amount == 0, "balance is not zero" );
+
+   sweep_candidates candidates( get_self(), symbol.raw() );
+   check( candidates.find( owner.value ) == candidates.end(), "balance is already nominated" );
+   candidates.emplace( payer, [&]( auto& c ) {
+      c.owner = owner;
+   });
+}
+
+uint64_t token::sweep( const symbol_code& symbol, const uint64_t cursor, const uint32_t limit ) {
+   check( limit > 0, "limit must be positive" );
+
+   stats statstable( get_self(), symbol.raw() );
+   const auto& st = statstable.get( symbol.raw(), "symbol does not exist" );
+   const uint32_t horizon = st.sweep_horizon_sec.value_or( 0 );
+   const time_point_sec now = current_time_point();
+
+   sweep_candidates candidates( get_self(), symbol.raw() );
+   auto it = candidates.lower_bound( cursor );
+   for( uint32_t checked = 0; it != candidates.end() && checked < limit; ++checked ) {
+      accounts acnts( get_self(), it->owner.value );
+      auto acc = acnts.find( symbol.raw() );
+      if( acc == acnts.end() || ( !it->allowed && acc->balance.amount != 0 ) ) {
+         // closed, hibernated or funded again since it was nominated, the entry has nothing left to sweep
+         it = candidates.erase( it );
+         continue;
+      }
+
+      const bool sweepable = acc->balance.amount == 0 && !acc->is_frozen &&
+                             ( it->allowed || ( horizon > 0 && now >= last_active( *acc, st ) + horizon ) ) &&
+                             !has_subaccount_funds( it->owner, symbol );
+      if( !sweepable ) {
+         ++it;
+         continue;
+      }
+      acnts.erase( acc );
+      it = candidates.erase( it );
+   }
+   return it == candidates.end() ? 0 : it->owner.value;
+}
+
+checksum256 token::merkle_root( const name& owner, const asset& balance, const merkle_proof& proof ) {
+   checksum256 hash = merkle_leaf( owner, balance );
+
+   // siblings are listed from the root down, the walk goes up from the leaf
+   auto sibling = proof.siblings.rbegin();
+   for( int depth = 63; depth >= 0; --depth ) {
+      checksum256 other;
+      if( ( proof.bitmap >> depth ) & 1 ) {
+         check( sibling != proof.siblings.rend(), "merkle proof has too few siblings" );
+         other = *sibling++;
+      }
+      const bool is_right = ( owner.value >> ( 63 - depth ) ) & 1;
+      hash = is_right ? merkle_parent( other, hash ) : merkle_parent( hash, other );
+   }
+   check( sibling == proof.siblings.rend(), "merkle proof has too many siblings" );
+   return hash;
 }
 
 void token::logfee( const name& account, const asset& fee) {
    require_auth(get_self());
 }
 
-void token::sub_balance( const name& owner, const asset& value ) {
+asset token::sub_balance( const name& owner, const asset& value ) {
    accounts from_acnts( get_self(), owner.value );
 
    const auto& from = from_acnts.get( value.symbol.code().raw(), "no balance object found" );
    check( from.balance.amount >= value.amount, "overdrawn balance" );
    check( !from.is_frozen, "Sender account is frozen" );
 
+   // the row is billed to its authorizing owner, so it can grow to the current layout
    from_acnts.modify( from, owner, [&]( auto& a ) {
          a.balance -= value;
+         upgrade( a );
+         a.last_active.emplace( current_time_point() );
       });
+   return from.balance;
 }
 
-void token::add_balance( const name& owner, const asset& value, const name& ram_payer )
+asset token::add_balance( const name& owner, const asset& value, const name& ram_payer )
 {
    accounts to_acnts( get_self(), owner.value );
    auto to = to_acnts.find( value.symbol.code().raw() );
 
    if( to == to_acnts.end() ) {
-      to_acnts.emplace( ram_payer, [&]( auto& a ){
+      to = to_acnts.emplace( ram_payer, [&]( auto& a ){
         a.balance = value;
+        upgrade( a );
+        a.last_active.emplace( current_time_point() );
       });
    } else {
       check( !to->is_frozen, "Receiver account is frozen" );
+      // the row keeps its layout, growing it would bill a RAM payer which has not authorized this action
       to_acnts.modify( to, same_payer, [&]( auto& a ) {
         a.balance += value;
       });
    }
+   return to->balance;
+}
+
+void token::subdeposit( const name& owner, const uint64_t subaccount, const asset& quantity )
+{
+   require_auth( owner );
+
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must deposit positive quantity" );
+
+   stats statstable( get_self(), quantity.symbol.code().raw() );
+   const auto& st = statstable.get( quantity.symbol.code().raw(), "symbol does not exist" );
+
+   const auto balance = sub_balance( owner, quantity );
+   add_subaccount( owner, subaccount, quantity );
+   commit_balances( statstable, st, owner, { { owner, balance } } );
+}
+
+void token::subwithdraw( const name& owner, const uint64_t subaccount, const asset& quantity )
+{
+   require_auth( owner );
+
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must withdraw positive quantity" );
+
+   stats statstable( get_self(), quantity.symbol.code().raw() );
+   const auto& st = statstable.get( quantity.symbol.code().raw(), "symbol does not exist" );
+
+   sub_subaccount( owner, subaccount, quantity );
+   const auto balance = add_balance( owner, quantity, owner );
+   commit_balances( statstable, st, owner, { { owner, balance } } );
+}
+
+void token::submove( const name& owner, const uint64_t from, const uint64_t to, const asset& quantity )
+{
+   require_auth( owner );
+   check( from != to, "cannot move to same sub-account" );
+
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must move positive quantity" );
+
+   // a frozen owner cannot shuffle funds between its sub-accounts either
+   accounts acnts( get_self(), owner.value );
+   auto it = acnts.find( quantity.symbol.code().raw() );
+   check( it == acnts.end() || !it->is_frozen, "Sender account is frozen" );
+
+   sub_subaccount( owner, from, quantity );
+   add_subaccount( owner, to, quantity );
+}
+
+void token::sub_subaccount( const name& owner, const uint64_t id, const asset& value ) {
+   subaccounts subs( get_self(), owner.value );
+
+   const auto& sub = subs.get( id, "no sub-account object found" );
+   check( sub.balance.symbol == value.symbol, "sub-account holds a different token" );
+   check( sub.balance.amount >= value.amount, "overdrawn sub-account balance" );
+
+   if( sub.balance.amount == value.amount ) {
+      subs.erase( sub );
+   } else {
+      subs.modify( sub, same_payer, [&]( auto& s ) {
+         s.balance -= value;
+      });
+   }
+}
+
+void token::add_subaccount( const name& owner, const uint64_t id, const asset& value ) {
+   subaccounts subs( get_self(), owner.value );
+   auto sub = subs.find( id );
+
+   if( sub == subs.end() ) {
+      subs.emplace( owner, [&]( auto& s ){
+        s.id      = id;
+        s.balance = value;
+      });
+   } else {
+      check( sub->balance.symbol == value.symbol, "sub-account holds a different token" );
+      subs.modify( sub, same_payer, [&]( auto& s ) {
+        s.balance += value;
+      });
+   }
+}
+
+// Sub-account rows are erased once empty, so any row of the token holds funds
+bool token::has_subaccount_funds( const name& owner, const symbol_code& sym ) {
+   subaccounts subs( get_self(), owner.value );
+   auto by_symbol = subs.get_index<"bysymbol"_n>();
+   return by_symbol.find( sym.raw() ) != by_symbol.end();
 }
 
 void token::open( const name& owner, const symbol& symbol, const name& ram_payer )
@@ -179,6 +727,31 @@ void token::open( const name& owner, const symbol& symbol, const name& ram_payer
    if( it == acnts.end() ) {
       acnts.emplace( ram_payer, [&]( auto& a ){
         a.balance = asset{0, symbol};
+        upgrade( a );
+        a.last_active.emplace( current_time_point() );
+      });
+   }
+}
+
+void token::openbatch( const std::vector<name>& owners, const symbol& symbol, const name& ram_payer )
+{
+   require_auth( ram_payer );
+
+   auto sym_code_raw = symbol.code().raw();
+   stats statstable( get_self(), sym_code_raw );
+   const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
+   check( st.supply.symbol == symbol, "symbol precision mismatch" );
+
+   const time_point_sec now = current_time_point();
+   for( const auto& owner : owners ) {
+      accounts acnts( get_self(), owner.value );
+      if( acnts.find( sym_code_raw ) != acnts.end() ) continue;
+
+      check( is_account( owner ), "owner account does not exist" );
+      acnts.emplace( ram_payer, [&]( auto& a ){
+        a.balance = asset{0, symbol};
+        upgrade( a );
+        a.last_active.emplace( now );
       });
    }
 }
@@ -240,5 +813,48 @@ void token::switchexempt(const name& issuer, const symbol& symbol, const name& a
     }
 }
 
+void token::setnotify( const name& account, const bool notify ) {
+    require_auth( account );
+
+    notify_optouts optouts( get_self(), get_self().value );
+    auto it = optouts.find( account.value );
+    if( notify ) {
+       check( it != optouts.end(), "account is already notified" );
+       optouts.erase( it );
+    } else {
+       check( it == optouts.end(), "account is already opted out of notifications" );
+       optouts.emplace( account, [&]( auto& o ) {
+          o.account = account;
+       });
+    }
+}
+
+std::vector<owner_balance> token::getbalances( const std::vector<name>& owners, const std::vector<symbol_code>& sym_codes ) {
+    std::vector<owner_balance> result;
+    result.reserve( owners.size() * sym_codes.size() );
+
+    for( const auto& owner : owners ) {
+        for( const auto& sym_code : sym_codes ) {
+            if( auto balance = read_asset( get_self(), owner.value, "accounts"_n, sym_code ) ) {
+                result.push_back( owner_balance{ owner, *balance } );
+            }
+        }
+    }
+    return result;
+}
+
+std::vector<token_stats> token::getstats( const std::vector<symbol_code>& sym_codes ) {
+    std::vector<token_stats> result;
+    result.reserve( sym_codes.size() );
+
+    for( const auto& sym_code : sym_codes ) {
+        stats statstable( get_self(), sym_code.raw() );
+        auto existing = statstable.find( sym_code.raw() );
+        if( existing != statstable.end() ) {
+            result.push_back( token_stats{ existing->supply, existing->max_supply, existing->issuer, existing->fees } );
+        }
+    }
+    return result;
+}
 
 } /// namespace eosio
@@ -0,0 +1,29 @@
+#include <eosio.token/client.hpp>
+#include <eosio.token/eosio.token.hpp>
+
+using namespace eosio;
+
+/**
+ * Benchmark contract which pays `quantity` to every account in `recipients` through inline `transfer` actions,
+ * once through `action_wrapper` and once through the `eosio.token/client.hpp` helpers.
+ */
+class [[eosio::contract("token_payer")]] token_payer : public contract {
+   public:
+      using contract::contract;
+
+      [[eosio::action]]
+      void paywrapper( const name& token, const std::vector<name>& recipients, const asset& quantity, const std::string& memo ) {
+         eosio::token::transfer_action transfer( token, { get_self(), "active"_n } );
+         for( const auto& to : recipients ) {
+            transfer.send( get_self(), to, quantity, memo );
+         }
+      }
+
+      [[eosio::action]]
+      void payclient( const name& token, const std::vector<name>& recipients, const asset& quantity, const std::string& memo ) {
+         token_client::inline_transfers payouts( token, get_self() );
+         for( const auto& to : recipients ) {
+            payouts.send( to, quantity, memo );
+         }
+      }
+};
@@ -0,0 +1,59 @@
+#include <eosio.token/eosio.token.hpp>
+
+using namespace eosio;
+
+/**
+ * Benchmark contract which tallies balances held in `eosio.token`, the way a DAO tally contract would,
+ * once per read helper. Every action reads each of `owners` `rounds` times and returns the total amount.
+ */
+class [[eosio::contract("token_tally")]] token_tally : public contract {
+   public:
+      using contract::contract;
+
+      // one multi_index per read, aborts on a missing row
+      [[eosio::action]]
+      int64_t tallyget( const name& token, const std::vector<name>& owners, const symbol_code& sym, uint32_t rounds ) {
+         int64_t total = 0;
+         for( uint32_t r = 0; r < rounds; ++r ) {
+            for( const auto& owner : owners ) {
+               total += eosio::token::get_balance( token, owner, sym ).amount;
+            }
+         }
+         return total;
+      }
+
+      [[eosio::action]]
+      int64_t tallytry( const name& token, const std::vector<name>& owners, const symbol_code& sym, uint32_t rounds ) {
+         int64_t total = 0;
+         for( uint32_t r = 0; r < rounds; ++r ) {
+            for( const auto& owner : owners ) {
+               if( auto balance = eosio::token::try_get_balance( token, owner, sym ) ) {
+                  total += balance->amount;
+               }
+            }
+         }
+         return total;
+      }
+
+      [[eosio::action]]
+      int64_t tallybatch( const name& token, const std::vector<name>& owners, const symbol_code& sym, uint32_t rounds ) {
+         int64_t total = 0;
+         for( uint32_t r = 0; r < rounds; ++r ) {
+            for( const auto& balance : eosio::token::get_balances( token, owners, sym ) ) {
+               if( balance ) total += balance->amount;
+            }
+         }
+         return total;
+      }
+
+      [[eosio::action]]
+      int64_t tallyraw( const name& token, const std::vector<name>& owners, const symbol_code& sym, uint32_t rounds ) {
+         int64_t total = 0;
+         for( uint32_t r = 0; r < rounds; ++r ) {
+            for( const auto& owner : owners ) {
+               total += eosio::token::get_balance_amount( token, owner, sym );
+            }
+         }
+         return total;
+      }
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/**
+ * Machine-readable reports of the benchmark suites, and the baselines they are gated against.
+ *
+ * A suite writes its measures as a JSON object keyed by action to the path in its report variable, and compares
+ * them with the JSON baseline in its baseline variable, both set by CTest. Running a suite with its record
+ * variable set to 1 writes the gated measures to the baseline instead, e.g. after an intended change:
+ *
+ *    EOSIO_TOKEN_CPU_RECORD=1 ctest -R eosio_token_bench
+ *    EOSIO_TOKEN_FOOTPRINT_RECORD=1 ctest -R eosio_token_bench
+ */
+namespace bench {
+
+   inline std::string env( const char* var, const std::string& fallback = {} ) {
+      const char* value = std::getenv( var );
+      return value && *value ? value : fallback;
+   }
+
+   inline bool recording( const char* var ) {
+      return env( var ) == "1";
+   }
+
+   /// Distribution of one measure, e.g. the billed CPU of every `transfer`.
+   struct distribution {
+      std::vector<int64_t> samples;
+
+      void add( int64_t value ) { samples.push_back( value ); }
+
+      int64_t percentile( double p )const {
+         if( samples.empty() ) return 0;
+         auto sorted = samples;
+         std::sort( sorted.begin(), sorted.end() );
+         return sorted[ std::min( sorted.size() - 1, size_t( p / 100 * sorted.size() ) ) ];
+      }
+
+      double average()const {
+         return samples.empty() ? 0 : double( std::accumulate( samples.begin(), samples.end(), int64_t(0) ) ) / samples.size();
+      }
+
+      fc::variant to_variant()const {
+         return fc::mutable_variant_object()
+            ( "samples", samples.size() )
+            ( "avg", average() )
+            ( "min", percentile( 0 ) )
+            ( "p50", percentile( 50 ) )
+            ( "p90", percentile( 90 ) )
+            ( "p99", percentile( 99 ) )
+            ( "max", percentile( 100 ) );
+      }
+   };
+
+   inline void save( const fc::variant& report, const std::string& path ) {
+      if( path.empty() ) return;
+      fc::json::save_to_file( report, path, true );
+   }
+
+   /// The baseline at `path`, an empty object if none has been recorded yet.
+   inline fc::variant_object load( const std::string& path ) {
+      if( path.empty() || !fc::exists( path ) ) return fc::variant_object();
+      return fc::json::from_file( path ).get_object();
+   }
+
+} /// namespace bench
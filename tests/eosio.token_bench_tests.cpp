@@ -0,0 +1,431 @@
+#include "eosio.token_tester.hpp"
+#include "bench_report.hpp"
+#include "wasm_profile.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+/**
+ * Per-action CPU benchmark, gated against `baselines/cpu.json`.
+ *
+ * Every action runs `EOSIO_TOKEN_BENCH_ROUNDS` times (1000 by default), each in its own transaction, and the billed
+ * CPU and elapsed time of the traces are written to `EOSIO_TOKEN_CPU_REPORT`. The test fails when the median billed
+ * CPU of an action exceeds its baseline by more than `EOSIO_TOKEN_CPU_THRESHOLD` percent (25 by default), or when
+ * an action has no baseline, which is recorded on the reference machine with `EOSIO_TOKEN_CPU_RECORD=1`. Until a
+ * baseline is recorded at all, the gate is skipped.
+ *
+ * RAM and NET footprint, gated against `baselines/footprint.json`.
+ *
+ * The RAM billed to the payer and to the contract by one instance of each action, and its NET bytes, are written to
+ * `EOSIO_TOKEN_FOOTPRINT_REPORT`. They are deterministic, so any difference with the baseline fails the test, e.g.
+ * a new field in the `account` or `currency_stats` rows, and so does an action missing on either side. Until a
+ * baseline is recorded at all, only the refunds are checked.
+ *
+ * Block capacity, reported to `EOSIO_TOKEN_CAPACITY_REPORT` and as a table to `EOSIO_TOKEN_CAPACITY_TABLE`.
+ *
+ * Blocks are filled with one shape of transaction of a fee token until the block CPU or NET limit refuses one, over
+ * `EOSIO_TOKEN_CAPACITY_BLOCKS` blocks (3 by default), giving the transactions per block and per second at the
+ * block interval. Rejected transfers are never included in a block, so their capacity is the number the producer
+ * can evaluate within the block CPU limit. The capacity follows the billed CPU, so it is only reported.
+ *
+ * Instruction profile, reported to `EOSIO_TOKEN_PROFILE_REPORT` and as collapsed stacks to `EOSIO_TOKEN_PROFILE_FOLDED`.
+ *
+ * The contract, or the wasm at `EOSIO_TOKEN_PROFILE_WASM`, is instrumented by `wasm_profile` and each action counts
+ * the wasm instructions it executes in every function. The counts are the same on every machine, so reports of two
+ * builds can be compared exactly. A build which keeps the `name` section gives the functions their names.
+ */
+class eosio_token_bench_tester : public eosio_token_tester {
+public:
+
+   // one action in its own transaction, the expiration varies so that repeated actions are distinct transactions
+   signed_transaction make_transaction( const vector<account_name>& signers, const action_name& name, const variant_object& data ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( make_action( signers, name, data ) );
+      set_transaction_headers( trx, 60 + sequence++ % 3000 );
+      for( const auto& signer : signers ) {
+         trx.sign( get_private_key( signer, "active" ), control->get_chain_id() );
+      }
+      return trx;
+   }
+
+   transaction_trace_ptr push( const vector<account_name>& signers, const action_name& name, const variant_object& data ) {
+      auto trx = make_transaction( signers, name, data );
+      // billed from the measured CPU time, rather than the fixed time the tester bills by default
+      return push_transaction( trx, fc::time_point::maximum(), 0 );
+   }
+
+   void measure( const string& label, const vector<account_name>& signers, const action_name& name, const variant_object& data ) {
+      const auto trace = push( signers, name, data );
+      billed[label].add( trace->receipt->cpu_usage_us );
+      elapsed[label].add( trace->elapsed.count() );
+   }
+
+   fc::variant report()const {
+      fc::mutable_variant_object actions;
+      for( const auto& [label, usage] : billed ) {
+         actions( label, mvo()
+            ( "billed_us", usage.to_variant() )
+            ( "elapsed_us", elapsed.at( label ).to_variant() ) );
+      }
+      return actions;
+   }
+
+   // pushes one action and records what it costs `payer` and the contract in RAM, and the transaction in NET
+   void footprint( const string& label, account_name payer, const vector<account_name>& signers,
+                   const action_name& name, const variant_object& data ) {
+      const auto payer_ram = get_ram_usage( payer );
+      const auto contract_ram = get_ram_usage( "eosio.token"_n );
+      const auto trace = push( signers, name, data );
+      produce_block();
+
+      footprints( label, mvo()
+         ( "payer", payer )
+         ( "payer_ram", get_ram_usage( payer ) - payer_ram )
+         ( "contract_ram", get_ram_usage( "eosio.token"_n ) - contract_ram )
+         ( "action_bytes", fc::raw::pack_size( make_action( signers, name, data ) ) )
+         ( "net_usage", trace->net_usage ) );
+   }
+
+   // pushes the transactions of `next` into the pending block until one does not fit in its CPU or NET limit,
+   // returns how many did and which limit was reached
+   std::pair<uint32_t, string> fill_block( const std::function<void()>& next ) {
+      uint32_t count = 0;
+      string limit;
+      try {
+         for( ;; ++count ) next();
+      } catch( const block_cpu_usage_exceeded& ) {
+         limit = "cpu";
+      } catch( const block_net_usage_exceeded& ) {
+         limit = "net";
+      }
+      produce_block();
+      return { count, limit };
+   }
+
+   uint32_t sequence = 0;
+   fc::mutable_variant_object footprints;
+   std::map<string, bench::distribution> billed, elapsed;
+};
+
+BOOST_AUTO_TEST_SUITE(eosio_token_bench_tests)
+
+BOOST_FIXTURE_TEST_CASE( per_action_cpu, eosio_token_bench_tester ) try {
+
+   const uint32_t rounds = std::stoul( bench::env( "EOSIO_TOKEN_BENCH_ROUNDS", "1000" ) );
+   const double threshold = std::stod( bench::env( "EOSIO_TOKEN_CPU_THRESHOLD", "25" ) );
+   const auto quantity = asset::from_string( "1.0000 TKN" );
+
+   create_accounts( { "dave"_n } );
+   create( "alice"_n, asset::from_string("100000000.0000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, quantity, "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "carol"_n, asset::from_string("100000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice"_n, "switchexempt"_n, mvo()
+                                                   ( "issuer", "alice")( "symbol", "4,TKN")( "account", "carol") ) );
+
+   for( uint32_t i = 0; i < rounds; ++i ) {
+      // a new token per round, named from the round number
+      string code = "B";
+      for( uint32_t n = i, digits = 0; digits < 4; n /= 26, ++digits ) code += char( 'A' + n % 26 );
+
+      measure( "create", { "eosio.token"_n }, "create"_n, mvo()
+         ( "issuer", "alice")( "maximum_supply", "1000.0000 " + code ) );
+      measure( "issue", { "alice"_n }, "issue"_n, mvo()
+         ( "to", "alice")( "quantity", "100.0000 TKN")( "memo", "") );
+      measure( "retire", { "alice"_n }, "retire"_n, mvo()
+         ( "quantity", "1.0000 TKN")( "memo", "") );
+      measure( "transfer", { "alice"_n }, "transfer"_n, mvo()
+         ( "from", "alice")( "to", "bob")( "quantity", quantity)( "memo", "") );
+      measure( "transfer_exempt", { "carol"_n }, "transfer"_n, mvo()
+         ( "from", "carol")( "to", "bob")( "quantity", quantity)( "memo", "") );
+      measure( "open", { "dave"_n }, "open"_n, mvo()
+         ( "owner", "dave")( "symbol", "4,TKN")( "ram_payer", "dave") );
+      measure( "close", { "dave"_n }, "close"_n, mvo()
+         ( "owner", "dave")( "symbol", "4,TKN") );
+      for( bool status : { true, false } ) {
+         measure( "freeze", { "alice"_n }, "freeze"_n, mvo()
+            ( "account", "bob")( "symbol", "4,TKN")( "status", status) );
+      }
+      measure( "setfee", { "alice"_n }, "setfee"_n, mvo()
+         ( "issuer", "alice")( "symbol", "4,TKN")( "fees", 10 + i % 2) );
+      // added then removed
+      for( uint32_t toggle = 0; toggle < 2; ++toggle ) {
+         measure( "switchexempt", { "alice"_n }, "switchexempt"_n, mvo()
+            ( "issuer", "alice")( "symbol", "4,TKN")( "account", "dave") );
+      }
+
+      if( i % 10 == 9 ) produce_block();
+   }
+   produce_block();
+
+   const auto actions = report();
+   bench::save( mvo()( "rounds", rounds )( "actions", actions ), bench::env( "EOSIO_TOKEN_CPU_REPORT" ) );
+
+   const auto baseline_path = bench::env( "EOSIO_TOKEN_CPU_BASELINE" );
+   if( bench::recording( "EOSIO_TOKEN_CPU_RECORD" ) ) {
+      fc::mutable_variant_object baseline;
+      for( const auto& [label, usage] : billed ) {
+         baseline( label, mvo()( "billed_us_p50", usage.percentile( 50 ) ) );
+      }
+      bench::save( baseline, baseline_path );
+      BOOST_TEST_MESSAGE( "recorded CPU baseline to " << baseline_path );
+      return;
+   }
+
+   const auto baseline = bench::load( baseline_path );
+   if( baseline.size() == 0 ) {
+      BOOST_TEST_MESSAGE( "CPU gate skipped, no baseline recorded in " << baseline_path
+                          << ", record it on the reference machine with EOSIO_TOKEN_CPU_RECORD=1" );
+      return;
+   }
+   for( const auto& [label, usage] : billed ) {
+      const auto median = usage.percentile( 50 );
+      BOOST_TEST_MESSAGE( label << ": billed p50 " << median << " us, p99 " << usage.percentile( 99 )
+                          << " us, elapsed p50 " << elapsed[label].percentile( 50 ) << " us" );
+      if( !baseline.contains( label.c_str() ) ) {
+         BOOST_ERROR( label << ": no CPU baseline recorded in " << baseline_path );
+         continue;
+      }
+      const auto limit = baseline[label]["billed_us_p50"].as_int64() * ( 1 + threshold / 100 );
+      BOOST_CHECK_MESSAGE( median <= limit, label << ": billed p50 " << median << " us exceeds the baseline "
+                           << baseline[label]["billed_us_p50"].as_int64() << " us by more than " << threshold << "%" );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( ram_and_net_footprint, eosio_token_bench_tester ) try {
+
+   create_accounts( { "dave"_n } );
+
+   footprint( "create", "eosio.token"_n, { "eosio.token"_n }, "create"_n, mvo()
+      ( "issuer", "alice")( "maximum_supply", "1000000.0000 TKN") );
+   footprint( "issue", "alice"_n, { "alice"_n }, "issue"_n, mvo()
+      ( "to", "alice")( "quantity", "1000.0000 TKN")( "memo", "") );
+   footprint( "transfer_first_receipt", "alice"_n, { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", "") );
+   footprint( "transfer", "alice"_n, { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", "") );
+   footprint( "open", "dave"_n, { "dave"_n }, "open"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN")( "ram_payer", "dave") );
+   footprint( "close", "dave"_n, { "dave"_n }, "close"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN") );
+   footprint( "exemption_add", "alice"_n, { "alice"_n }, "switchexempt"_n, mvo()
+      ( "issuer", "alice")( "symbol", "4,TKN")( "account", "dave") );
+   footprint( "exemption_remove", "alice"_n, { "alice"_n }, "switchexempt"_n, mvo()
+      ( "issuer", "alice")( "symbol", "4,TKN")( "account", "dave") );
+
+   const fc::variant_object report = footprints;
+   bench::save( report, bench::env( "EOSIO_TOKEN_FOOTPRINT_REPORT" ) );
+
+   // what is billed is refunded
+   BOOST_REQUIRE( report["open"]["payer_ram"].as_int64() > 0 );
+   BOOST_REQUIRE_EQUAL( report["open"]["payer_ram"].as_int64(), -report["close"]["payer_ram"].as_int64() );
+   BOOST_REQUIRE( report["exemption_add"]["contract_ram"].as_int64() > 0 );
+   BOOST_REQUIRE_EQUAL( report["exemption_add"]["contract_ram"].as_int64(), -report["exemption_remove"]["contract_ram"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 0, report["transfer"]["payer_ram"].as_int64() );
+
+   const auto baseline_path = bench::env( "EOSIO_TOKEN_FOOTPRINT_BASELINE" );
+   if( bench::recording( "EOSIO_TOKEN_FOOTPRINT_RECORD" ) ) {
+      bench::save( report, baseline_path );
+      BOOST_TEST_MESSAGE( "recorded footprint baseline to " << baseline_path );
+      return;
+   }
+
+   const auto baseline = bench::load( baseline_path );
+   if( baseline.size() == 0 ) {
+      BOOST_TEST_MESSAGE( "footprint gate skipped, no baseline recorded in " << baseline_path
+                          << ", record it with EOSIO_TOKEN_FOOTPRINT_RECORD=1" );
+      return;
+   }
+   for( const auto& entry : report ) {
+      const auto& measures = entry.value().get_object();
+      BOOST_TEST_MESSAGE( entry.key() << ": payer RAM " << measures["payer_ram"].as_int64() << " bytes, contract RAM "
+                          << measures["contract_ram"].as_int64() << " bytes, action " << measures["action_bytes"].as_uint64()
+                          << " bytes, NET " << measures["net_usage"].as_uint64() << " bytes" );
+      if( !baseline.contains( entry.key().c_str() ) ) {
+         BOOST_ERROR( entry.key() << ": no footprint baseline recorded in " << baseline_path );
+         continue;
+      }
+      for( const auto& measure : baseline[entry.key()].get_object() ) {
+         BOOST_CHECK_MESSAGE( measure.value() == measures[measure.key()],
+                              entry.key() << ": " << measure.key() << " is " << fc::json::to_string( measures[measure.key()], fc::time_point::maximum() )
+                              << ", baseline " << fc::json::to_string( measure.value(), fc::time_point::maximum() ) );
+      }
+   }
+   for( const auto& entry : baseline ) {
+      BOOST_CHECK_MESSAGE( report.contains( entry.key().c_str() ), entry.key() << ": in the baseline but no longer measured" );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( block_capacity, eosio_token_bench_tester ) try {
+
+   const uint32_t blocks = std::stoul( bench::env( "EOSIO_TOKEN_CAPACITY_BLOCKS", "3" ) );
+   const auto& limits = control->get_global_properties().configuration;
+   const double blocks_per_sec = 1000.0 / config::block_interval_ms;
+   const auto quantity = asset::from_string( "1.0000 TKN" );
+
+   // every included transaction bills at least the minimum CPU, which bounds the new rows a block can take
+   const auto recipients = make_names( "row", limits.max_block_cpu_usage / limits.min_transaction_cpu_usage * blocks );
+   for( size_t i = 0; i < recipients.size(); i += 500 ) {
+      create_accounts( vector<account_name>( recipients.begin() + i, recipients.begin() + std::min( i + 500, recipients.size() ) ) );
+   }
+   create_accounts( { "dave"_n } );
+
+   create( "alice"_n, asset::from_string("100000000.0000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("10000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, quantity, "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "carol"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "dave"_n, asset::from_string("1000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice"_n, "setfee"_n, mvo()
+                                                   ( "issuer", "alice")( "symbol", "4,TKN")( "fees", 10) ) );
+   BOOST_REQUIRE_EQUAL( success(), push_action( "alice"_n, "switchexempt"_n, mvo()
+                                                   ( "issuer", "alice")( "symbol", "4,TKN")( "account", "carol") ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze( "alice"_n, "dave"_n, "4,TKN", true ) );
+
+   size_t next_recipient = 0;
+   const vector<std::pair<string, std::function<void()>>> shapes = {
+      { "transfer", [&]{ push( { "alice"_n }, "transfer"_n, mvo()
+         ( "from", "alice")( "to", "bob")( "quantity", quantity)( "memo", "") ); } },
+      { "transfer_new_row", [&]{ push( { "alice"_n }, "transfer"_n, mvo()
+         ( "from", "alice")( "to", recipients.at( next_recipient++ ))( "quantity", quantity)( "memo", "") ); } },
+      { "transfer_exempt", [&]{ push( { "carol"_n }, "transfer"_n, mvo()
+         ( "from", "carol")( "to", "bob")( "quantity", quantity)( "memo", "") ); } },
+      { "issue", [&]{ push( { "alice"_n }, "issue"_n, mvo()
+         ( "to", "alice")( "quantity", quantity)( "memo", "") ); } },
+   };
+
+   fc::mutable_variant_object actions;
+   std::ostringstream table;
+   table << "| transaction | per block (min) | per block (avg) | per second | limited by |\n"
+         << "|---|---|---|---|---|\n";
+   const auto add_row = [&]( const string& label, const bench::distribution& per_block, const string& limit ) {
+      actions( label, mvo()
+         ( "per_block", per_block.to_variant() )
+         ( "per_sec", per_block.average() * blocks_per_sec )
+         ( "limited_by", limit ) );
+      table << "| " << label << " | " << per_block.percentile( 0 ) << " | " << per_block.average() << " | "
+            << per_block.average() * blocks_per_sec << " | " << limit << " |\n";
+   };
+
+   for( const auto& [label, next] : shapes ) {
+      bench::distribution per_block;
+      std::map<string, uint32_t> limited_by;
+      for( uint32_t b = 0; b < blocks; ++b ) {
+         const auto [count, limit] = fill_block( next );
+         BOOST_REQUIRE( count > 0 );
+         per_block.add( count );
+         ++limited_by[limit];
+      }
+      const auto most = std::max_element( limited_by.begin(), limited_by.end(),
+                                          []( const auto& a, const auto& b ) { return a.second < b.second; } );
+      add_row( label, per_block, most->first );
+   }
+
+   // a rejected transaction takes the time of the producer without being included in the block
+   bench::distribution rejected;
+   for( uint32_t b = 0; b < blocks; ++b ) {
+      int64_t spent_us = 0;
+      uint32_t count = 0;
+      for( ; spent_us < limits.max_block_cpu_usage; ++count ) {
+         auto trx = make_transaction( { "dave"_n }, "transfer"_n, mvo()
+            ( "from", "dave")( "to", "bob")( "quantity", quantity)( "memo", "") );
+         const auto start = fc::time_point::now();
+         BOOST_REQUIRE_EXCEPTION( push_transaction( trx, fc::time_point::maximum(), 0 ), eosio_assert_message_exception,
+                                  eosio_assert_message_is( "Sender account is frozen" ) );
+         spent_us += ( fc::time_point::now() - start ).count();
+      }
+      rejected.add( count );
+      produce_block();
+   }
+   add_row( "transfer_frozen_rejected", rejected, "producer time" );
+
+   BOOST_TEST_MESSAGE( "block capacity at " << limits.max_block_cpu_usage << " us CPU, " << limits.max_block_net_usage
+                       << " bytes NET and " << config::block_interval_ms << " ms per block:\n" << table.str() );
+   bench::save( mvo()
+      ( "max_block_cpu_usage", limits.max_block_cpu_usage )
+      ( "max_block_net_usage", limits.max_block_net_usage )
+      ( "block_interval_ms", config::block_interval_ms )
+      ( "blocks", blocks )
+      ( "actions", actions ), bench::env( "EOSIO_TOKEN_CAPACITY_REPORT" ) );
+
+   const auto table_path = bench::env( "EOSIO_TOKEN_CAPACITY_TABLE" );
+   if( !table_path.empty() ) {
+      std::ofstream( table_path ) << table.str();
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( instruction_profile, eosio_token_bench_tester ) try {
+
+   const auto wasm_path = bench::env( "EOSIO_TOKEN_PROFILE_WASM" );
+   std::vector<uint8_t> wasm = contracts::token_wasm();
+   if( !wasm_path.empty() ) {
+      std::ifstream in( wasm_path, std::ios::binary );
+      BOOST_REQUIRE_MESSAGE( in, "cannot read " << wasm_path );
+      wasm.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+   }
+   const auto profiled = wasm_profile::instrument( wasm, "token" );
+   set_code( "eosio.token"_n, profiled.wasm );
+   produce_block();
+   create_accounts( { "dave"_n } );
+
+   fc::mutable_variant_object actions;
+   std::ostringstream folded;
+   const auto profile = [&]( const string& label, const vector<account_name>& signers, const action_name& name, const variant_object& data ) {
+      const auto trace = push( signers, name, data );
+      produce_block();
+      const auto counts = wasm_profile::counts( trace->action_traces.front().console, profiled );
+      BOOST_REQUIRE_MESSAGE( counts, label << ": the action printed no instruction counts" );
+
+      std::vector<std::pair<uint32_t, string>> functions;
+      uint64_t total = 0;
+      for( size_t k = 0; k < profiled.counters.size(); ++k ) {
+         if( (*counts)[k] == 0 ) continue;
+         functions.emplace_back( (*counts)[k], profiled.counters[k] );
+         total += (*counts)[k];
+      }
+      std::sort( functions.rbegin(), functions.rend() );
+
+      fc::mutable_variant_object by_function;
+      for( const auto& [count, function] : functions ) {
+         by_function( function, count );
+         folded << label << ";" << function << " " << count << "\n";
+      }
+      actions( label, mvo()( "instructions", total )( "functions", by_function ) );
+      BOOST_TEST_MESSAGE( label << ": " << total << " instructions in " << functions.size() << " functions" );
+      return total;
+   };
+
+   profile( "create", { "eosio.token"_n }, "create"_n, mvo()
+      ( "issuer", "alice")( "maximum_supply", "1000000.0000 TKN") );
+   profile( "issue", { "alice"_n }, "issue"_n, mvo()
+      ( "to", "alice")( "quantity", "1000.0000 TKN")( "memo", "") );
+   profile( "transfer_first_receipt", { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", "") );
+   const auto transfer = profile( "transfer", { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", "") );
+   profile( "open", { "dave"_n }, "open"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN")( "ram_payer", "dave") );
+   profile( "close", { "dave"_n }, "close"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN") );
+   profile( "retire", { "alice"_n }, "retire"_n, mvo()
+      ( "quantity", "1.0000 TKN")( "memo", "") );
+
+   // the same action in another transaction executes the same instructions
+   BOOST_REQUIRE_EQUAL( transfer, profile( "transfer_again", { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", "") ) );
+
+   bench::save( mvo()( "counters", profiled.counters.size() )( "actions", actions ), bench::env( "EOSIO_TOKEN_PROFILE_REPORT" ) );
+   const auto folded_path = bench::env( "EOSIO_TOKEN_PROFILE_FOLDED" );
+   if( !folded_path.empty() ) {
+      std::ofstream( folded_path ) << folded.str();
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
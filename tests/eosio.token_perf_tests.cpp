@@ -0,0 +1,569 @@
+#include "eosio.token_tester.hpp"
+#include "wasm_profile.hpp"
+
+#include <fc/io/json.hpp>
+
+#include <functional>
+#include <map>
+#include <sstream>
+
+struct cpu_usage {
+   int64_t  billed_us  = 0;
+   int64_t  elapsed_us = 0;
+   uint32_t samples    = 0;
+
+   void add( const transaction_trace_ptr& trace ) {
+      billed_us  += trace->receipt->cpu_usage_us;
+      elapsed_us += trace->elapsed.count();
+      ++samples;
+   }
+
+   double avg_billed_us()const  { return samples ? double(billed_us) / samples : 0; }
+   double avg_elapsed_us()const { return samples ? double(elapsed_us) / samples : 0; }
+};
+
+BOOST_AUTO_TEST_SUITE(eosio_token_perf_tests)
+
+BOOST_FIXTURE_TEST_CASE( swap_vs_two_transfers, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000000 AAA"));
+   create( "bob"_n, asset::from_string("1000000000 BBB"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000000 AAA"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( "bob"_n, asset::from_string("1000000000 BBB"), "" ) );
+
+   // both balance rows exist on both sides before measuring
+   BOOST_REQUIRE_EQUAL( success(), swap( "alice"_n, "bob"_n, asset::from_string("10000 AAA"), asset::from_string("10000 BBB"), "" ) );
+
+   const uint32_t rounds = 200;
+   cpu_usage swaps, transfers;
+
+   for( uint32_t i = 0; i < rounds; ++i ) {
+      const auto memo = std::to_string(i);
+
+      swaps.add( push_actions( { make_action( { "alice"_n, "bob"_n }, "swap"_n, mvo()
+                                    ( "a", "alice")
+                                    ( "b", "bob")
+                                    ( "quantity_a", "10000 AAA")
+                                    ( "quantity_b", "10000 BBB")
+                                    ( "memo", memo) ) },
+                               { "alice"_n, "bob"_n } ) );
+
+      transfers.add( push_actions( { make_action( { "alice"_n }, "transfer"_n, mvo()
+                                        ( "from", "alice")
+                                        ( "to", "bob")
+                                        ( "quantity", "10000 AAA")
+                                        ( "memo", memo) ),
+                                     make_action( { "bob"_n }, "transfer"_n, mvo()
+                                        ( "from", "bob")
+                                        ( "to", "alice")
+                                        ( "quantity", "10000 BBB")
+                                        ( "memo", memo) ) },
+                                   { "alice"_n, "bob"_n } ) );
+      produce_block();
+   }
+
+   BOOST_TEST_MESSAGE( "swap:          avg billed " << swaps.avg_billed_us() << " us, avg elapsed " << swaps.avg_elapsed_us() << " us" );
+   BOOST_TEST_MESSAGE( "two transfers: avg billed " << transfers.avg_billed_us() << " us, avg elapsed " << transfers.avg_elapsed_us() << " us" );
+
+   BOOST_REQUIRE_EQUAL( rounds, swaps.samples );
+   BOOST_REQUIRE_EQUAL( rounds, transfers.samples );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( xfer_vs_transfer_with_memo, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000.0000 TKN"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), xfer( "alice"_n, "bob"_n, 10000, "TKN", 0 ) );
+
+   const uint32_t rounds = 200;
+   cpu_usage xfers, transfers;
+   uint64_t xfer_net = 0, transfer_net = 0;
+
+   for( uint32_t i = 0; i < rounds; ++i ) {
+      // a typical exchange deposit memo is the customer id as a decimal string
+      const uint64_t customer_id = 1000000000 + i;
+
+      auto trace = push_actions( { make_action( { "alice"_n }, "xfer"_n, mvo()
+                                      ( "from", "alice")
+                                      ( "to", "bob")
+                                      ( "amount", 10000)
+                                      ( "sym", "TKN")
+                                      ( "tag", customer_id) ) },
+                                 { "alice"_n } );
+      xfers.add( trace );
+      xfer_net += trace->net_usage;
+
+      trace = push_actions( { make_action( { "alice"_n }, "transfer"_n, mvo()
+                                 ( "from", "alice")
+                                 ( "to", "bob")
+                                 ( "quantity", "1.0000 TKN")
+                                 ( "memo", std::to_string(customer_id)) ) },
+                            { "alice"_n } );
+      transfers.add( trace );
+      transfer_net += trace->net_usage;
+      produce_block();
+   }
+
+   const auto xfer_data = make_action( { "alice"_n }, "xfer"_n, mvo()
+                                          ( "from", "alice")
+                                          ( "to", "bob")
+                                          ( "amount", 10000)
+                                          ( "sym", "TKN")
+                                          ( "tag", 1000000000) ).data.size();
+   const auto transfer_data = make_action( { "alice"_n }, "transfer"_n, mvo()
+                                              ( "from", "alice")
+                                              ( "to", "bob")
+                                              ( "quantity", "1.0000 TKN")
+                                              ( "memo", "1000000000") ).data.size();
+
+   BOOST_TEST_MESSAGE( "xfer:     " << xfer_data << " bytes of action data, avg net " << xfer_net / rounds
+                       << " bytes, avg billed " << xfers.avg_billed_us() << " us" );
+   BOOST_TEST_MESSAGE( "transfer: " << transfer_data << " bytes of action data, avg net " << transfer_net / rounds
+                       << " bytes, avg billed " << transfers.avg_billed_us() << " us" );
+
+   BOOST_REQUIRE_EQUAL( get_account("bob"_n, "4,TKN")["balance"].as_string(), "401.0000 TKN" );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( tally_read_helpers, eosio_token_tester ) try {
+
+   const auto holders = make_names( "holder", 50 );
+   const uint32_t rounds = 200; // 10k balance reads per tally
+
+   create_accounts( holders );
+   create_accounts( { "tally"_n } );
+   set_code( "tally"_n, contracts::util::tally_wasm() );
+   set_abi( "tally"_n, contracts::util::tally_abi().data() );
+
+   create( "alice"_n, asset::from_string("1000000.0000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   for( const auto& holder : holders ) {
+      BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, holder, asset::from_string("10.0000 TKN"), "" ) );
+   }
+
+   const int64_t expected = int64_t(holders.size()) * rounds * 100000;
+
+   for( auto action : { "tallyget"_n, "tallytry"_n, "tallybatch"_n, "tallyraw"_n } ) {
+      auto trace = base_tester::push_action( "tally"_n, action, "tally"_n, mvo()
+                                             ( "token", "eosio.token")
+                                             ( "owners", holders)
+                                             ( "sym", "TKN")
+                                             ( "rounds", rounds) );
+      BOOST_REQUIRE_EQUAL( expected, return_value( trace, "int64" ).as_int64() );
+      BOOST_TEST_MESSAGE( action << ": " << holders.size() * rounds << " reads, billed "
+                          << trace->receipt->cpu_usage_us << " us, elapsed " << trace->elapsed.count() << " us" );
+      produce_block();
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( inline_payouts, eosio_token_tester ) try {
+
+   const auto recipients = make_names( "payee", 500 );
+
+   create_accounts( recipients );
+   create_accounts( { "payer"_n } );
+   set_code( "payer"_n, contracts::util::payer_wasm() );
+   set_abi( "payer"_n, contracts::util::payer_abi().data() );
+
+   create( "alice"_n, asset::from_string("1000000.0000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "payer"_n, asset::from_string("10000.0000 TKN"), "" ) );
+
+   // the first round creates every recipient's balance row, the measured rounds only update them
+   for( auto action : { "paywrapper"_n, "paywrapper"_n, "payclient"_n } ) {
+      auto trace = base_tester::push_action( "payer"_n, action, "payer"_n, mvo()
+                                             ( "token", "eosio.token")
+                                             ( "recipients", recipients)
+                                             ( "quantity", "1.0000 TKN")
+                                             ( "memo", "payout") );
+      BOOST_TEST_MESSAGE( action << ": " << recipients.size() << " inline transfers, billed "
+                          << trace->receipt->cpu_usage_us << " us, elapsed " << trace->elapsed.count() << " us" );
+      produce_block();
+   }
+
+   for( const auto& to : recipients ) {
+      BOOST_REQUIRE_EQUAL( "3.0000 TKN", get_account( to, "4,TKN" )["balance"].as_string() );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transferid_sustained_retries, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000000 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("1 CERO"), "" ) );
+
+   // 100 payouts per deduplication window, each one retried once, for 10 windows
+   const uint32_t per_window = 100;
+   const uint32_t windows = 10;
+   const auto interval = fc::seconds( 24 * 3600 / per_window );
+
+   int64_t ram_after_second_window = 0;
+   int64_t peak_ram = 0;
+   for( uint32_t i = 0; i < per_window * windows; ++i ) {
+      BOOST_REQUIRE_EQUAL( success(), transferid( "alice"_n, "bob"_n, asset::from_string("1 CERO"), "", i ) );
+      BOOST_REQUIRE_EQUAL( wasm_assert_msg( "duplicate transfer request id" ),
+                           transferid( "alice"_n, "bob"_n, asset::from_string("1 CERO"), "", i ) );
+      produce_block( interval );
+
+      const auto ram = get_ram_usage( "alice"_n );
+      if( i == per_window * 2 - 1 ) ram_after_second_window = ram;
+      if( i >= per_window * 2 ) peak_ram = std::max( peak_ram, ram );
+   }
+
+   BOOST_TEST_MESSAGE( "alice RAM after 2 windows " << ram_after_second_window << " bytes, peak over the next "
+                       << windows - 2 << " windows " << peak_ram << " bytes" );
+   BOOST_REQUIRE( peak_ram <= ram_after_second_window );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( merkle_commitment_overhead, eosio_token_tester ) try {
+
+   const auto holders = make_names( "holder", 100 );
+   create_accounts( holders );
+
+   // same token twice, the second one commits its balances
+   create( "alice"_n, asset::from_string("1000000000 PLAIN"));
+   create( "alice"_n, asset::from_string("1000000000 MERKLE"));
+   BOOST_REQUIRE_EQUAL( success(), enablemerkle( "alice"_n, "0,MERKLE" ) );
+
+   for( const string sym : { "PLAIN", "MERKLE" } ) {
+      BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000000 " + sym), "" ) );
+
+      // first receipt of every holder, alice pays for the balance rows and the tree nodes
+      const auto contract_ram = get_ram_usage( "eosio.token"_n );
+      const auto payer_ram = get_ram_usage( "alice"_n );
+      cpu_usage first, existing;
+      for( const auto& holder : holders ) {
+         first.add( push_actions( { make_action( { "alice"_n }, "transfer"_n, mvo()
+                                       ( "from", "alice")
+                                       ( "to", holder)
+                                       ( "quantity", "1000 " + sym)
+                                       ( "memo", "") ) },
+                                  { "alice"_n } ) );
+      }
+      produce_block();
+      BOOST_REQUIRE_EQUAL( contract_ram, get_ram_usage( "eosio.token"_n ) );
+      const auto holder_ram = ( get_ram_usage( "alice"_n ) - payer_ram ) / holders.size();
+
+      for( uint32_t i = 0; i < holders.size(); ++i ) {
+         existing.add( push_actions( { make_action( { holders[i] }, "transfer"_n, mvo()
+                                          ( "from", holders[i])
+                                          ( "to", holders[(i + 1) % holders.size()])
+                                          ( "quantity", "1 " + sym)
+                                          ( "memo", "") ) },
+                                     { holders[i] } ) );
+      }
+      produce_block();
+
+      BOOST_TEST_MESSAGE( sym << ": new row avg billed " << first.avg_billed_us() << " us, existing rows avg billed "
+                          << existing.avg_billed_us() << " us, elapsed " << existing.avg_elapsed_us() << " us, payer RAM "
+                          << holder_ram << " bytes per new holder" );
+   }
+
+   // a leaf sits where its path parts from the others, so the tree grows with the holders rather than 64 nodes each
+   const auto nodes = get_merkle_nodes("0,MERKLE");
+   BOOST_TEST_MESSAGE( "MERKLE: " << nodes.size() << " tree nodes for " << holders.size() + 1 << " holders" );
+   BOOST_REQUIRE( nodes.size() < 2 * ( holders.size() + 1 ) );
+   BOOST_REQUIRE_EQUAL( true, get_merkle_nodes("0,PLAIN").empty() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( hot_contract_size_and_cold_start ) try {
+
+   if( !contracts::token_hot_built ) {
+      BOOST_TEST_MESSAGE( "skipped, eosio.token.hot is only built with BUILD_HOT_CONTRACT=ON" );
+      return;
+   }
+
+   struct layout {
+      const char*      name;
+      vector<uint8_t>  wasm;
+      vector<char>     abi;
+   };
+   const layout layouts[] = {
+      { "full", contracts::token_wasm(), contracts::token_abi() },
+      { "hot",  contracts::token_hot_wasm(), contracts::token_hot_abi() },
+   };
+
+   for( const auto& l : layouts ) {
+      // a fresh chain per layout, so that the first transfer instantiates a module no action has used yet
+      eosio_token_tester t;
+      t.deploy( contracts::token_v1_wasm(), contracts::token_v1_abi() );
+      t.create( "alice"_n, asset::from_string("1000000.0000 TKN"));
+      BOOST_REQUIRE_EQUAL( t.success(), t.issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+      t.deploy( l.wasm, l.abi );
+
+      auto transfer = [&]( const string& memo ) {
+         return t.push_actions( { t.make_action( { "alice"_n }, "transfer"_n, mvo()
+                                     ( "from", "alice")
+                                     ( "to", "bob")
+                                     ( "quantity", "1.0000 TKN")
+                                     ( "memo", memo) ) },
+                                { "alice"_n } );
+      };
+
+      const auto first = transfer( "cold" );
+      t.produce_block();
+      cpu_usage warm;
+      for( uint32_t i = 0; i < 100; ++i ) {
+         warm.add( transfer( std::to_string(i) ) );
+      }
+      t.produce_block();
+
+      BOOST_TEST_MESSAGE( l.name << ": wasm " << l.wasm.size() << " bytes, abi " << l.abi.size()
+                          << " bytes, first transfer elapsed " << first->elapsed.count() << " us (billed "
+                          << first->receipt->cpu_usage_us << " us), warm avg elapsed " << warm.avg_elapsed_us() << " us" );
+   }
+
+   BOOST_REQUIRE( layouts[1].wasm.size() < layouts[0].wasm.size() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( sweep_rows_per_ms, eosio_token_tester ) try {
+
+   const auto holders = make_names( "empty", 1000 );
+   const uint32_t batch = 100;
+   create_accounts( holders );
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), setsweep( "alice"_n, "CERO", 1 ) );
+
+   // alice opens every row and nominates it, so the sweep refunds her
+   for( auto act_name : { "open"_n, "nominate"_n } ) {
+      for( size_t i = 0; i < holders.size(); i += batch ) {
+         vector<action> acts;
+         for( size_t j = i; j < i + batch; ++j ) {
+            acts.push_back( act_name == "open"_n
+               ? make_action( { "alice"_n }, act_name, mvo()( "owner", holders[j] )( "symbol", "0,CERO" )( "ram_payer", "alice" ) )
+               : make_action( { "alice"_n }, act_name, mvo()( "payer", "alice" )( "owner", holders[j] )( "symbol", "CERO" ) ) );
+         }
+         push_actions( std::move(acts), { "alice"_n } );
+         produce_block();
+      }
+   }
+   produce_block( fc::seconds( 2 ) );
+
+   const auto ram = get_ram_usage( "alice"_n );
+   const uint32_t limit = 250;
+   uint64_t cursor = 0;
+   cpu_usage sweeps;
+   do {
+      auto trace = base_tester::push_action( "eosio.token"_n, "sweep"_n, "bob"_n, mvo()
+                                             ( "symbol", "CERO")
+                                             ( "cursor", cursor)
+                                             ( "limit", limit) );
+      sweeps.add( trace );
+      cursor = return_value( trace, "uint64" ).as_uint64();
+      produce_block();
+   } while( cursor != 0 );
+
+   for( const auto& holder : holders ) {
+      BOOST_REQUIRE_EQUAL( true, get_account( holder, "0,CERO" ).is_null() );
+   }
+
+   BOOST_TEST_MESSAGE( "sweep: " << holders.size() << " rows in " << sweeps.samples << " calls of " << limit
+                       << ", avg billed " << sweeps.avg_billed_us() << " us, avg elapsed " << sweeps.avg_elapsed_us()
+                       << " us, " << holders.size() * 1000.0 / sweeps.elapsed_us << " rows/ms, "
+                       << ram - get_ram_usage( "alice"_n ) << " bytes refunded to alice" );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( openbatch_onboarding, eosio_token_tester ) try {
+
+   const auto users = make_names( "user", 10000 );
+   const uint32_t batch = 500;
+   for( size_t i = 0; i < users.size(); i += batch ) {
+      create_accounts( vector<account_name>( users.begin() + i, users.begin() + i + batch ) );
+   }
+
+   create( "alice"_n, asset::from_string("1000.0000 ONE"));
+   create( "alice"_n, asset::from_string("1000.0000 BAT"));
+
+   // one `open` per owner, packed `batch` to a transaction, against one `openbatch` per `batch` owners
+   cpu_usage opens, batches;
+   for( size_t i = 0; i < users.size(); i += batch ) {
+      vector<action> acts;
+      for( size_t j = i; j < i + batch; ++j ) {
+         acts.push_back( make_action( { "alice"_n }, "open"_n, mvo()
+                            ( "owner", users[j] )
+                            ( "symbol", "4,ONE" )
+                            ( "ram_payer", "alice" ) ) );
+      }
+      opens.add( push_actions( std::move(acts), { "alice"_n } ) );
+
+      batches.add( push_actions( { make_action( { "alice"_n }, "openbatch"_n, mvo()
+                                      ( "owners", vector<account_name>( users.begin() + i, users.begin() + i + batch ) )
+                                      ( "symbol", "4,BAT" )
+                                      ( "ram_payer", "alice" ) ) },
+                                 { "alice"_n } ) );
+      produce_block();
+   }
+
+   for( const auto& [label, usage] : { std::make_pair( "open", opens ), std::make_pair( "openbatch", batches ) } ) {
+      BOOST_TEST_MESSAGE( label << ": " << users.size() << " rows in " << usage.samples << " transactions, billed "
+                          << usage.billed_us << " us, elapsed " << usage.elapsed_us << " us, "
+                          << users.size() * 1000.0 / usage.elapsed_us << " rows/ms" );
+   }
+
+   BOOST_REQUIRE_EQUAL( "0.0000 BAT", get_account( users.back(), "4,BAT" )["balance"].as_string() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( notification_optout_traces, eosio_token_tester ) try {
+
+   const auto users = make_names( "quiet", 100 );
+   create_accounts( users );
+
+   create( "alice"_n, asset::from_string("1000000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000 CERO"), "" ) );
+   for( const auto& user : users ) {
+      BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, user, asset::from_string("1000 CERO"), "" ) );
+   }
+
+   // user-to-user transfers, each user paying the next one
+   auto run = [&]( const char* label ) {
+      size_t action_traces = 0, bytes = 0;
+      cpu_usage usage;
+      for( uint32_t i = 0; i < users.size(); ++i ) {
+         auto trace = push_actions( { make_action( { users[i] }, "transfer"_n, mvo()
+                                         ( "from", users[i])
+                                         ( "to", users[(i + 1) % users.size()])
+                                         ( "quantity", "1 CERO")
+                                         ( "memo", "") ) },
+                                    { users[i] } );
+         usage.add( trace );
+         action_traces += trace->action_traces.size();
+         bytes += fc::json::to_string( fc::variant( *trace ), fc::time_point::maximum() ).size();
+      }
+      produce_block();
+      BOOST_TEST_MESSAGE( label << ": " << users.size() << " transfers, " << action_traces << " action traces, "
+                          << bytes << " bytes of JSON traces, avg billed " << usage.avg_billed_us() << " us" );
+      return action_traces;
+   };
+
+   const auto notified = run( "notified" );
+   for( const auto& user : users ) {
+      BOOST_REQUIRE_EQUAL( success(), setnotify( user, false ) );
+   }
+   const auto quiet = run( "opted out" );
+
+   BOOST_REQUIRE_EQUAL( users.size() * 3, notified );
+   BOOST_REQUIRE_EQUAL( users.size(), quiet );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( harness_variant_vs_raw, eosio_token_tester ) try {
+
+   const uint32_t rounds = 1000;
+   const auto sym = symbol::from_string( "4,TKN" );
+   const auto quantity = asset::from_string( "1.0000 TKN" );
+
+   create( "alice"_n, asset::from_string("1000000.0000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000.0000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, quantity, "" ) );
+   produce_block();
+
+   // wall-clock time of the harness and the chain, against the time the chain spent in the transactions
+   const auto run = [&]( const char* label, const std::function<transaction_trace_ptr( uint32_t )>& push,
+                         const std::function<void()>& read ) {
+      cpu_usage usage;
+      const auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < rounds; ++i ) {
+         usage.add( push( i ) );
+         if( i % 100 == 99 ) produce_block();
+      }
+      const auto pushed = fc::time_point::now();
+      for( uint32_t i = 0; i < rounds; ++i ) read();
+      const auto read_us = ( fc::time_point::now() - pushed ).count();
+      const auto push_us = ( pushed - start ).count();
+
+      BOOST_TEST_MESSAGE( label << ": " << rounds * 1000000.0 / push_us << " transfers/s, harness "
+                          << double( push_us - usage.elapsed_us ) / rounds << " us and chain "
+                          << usage.avg_elapsed_us() << " us per transfer, " << double( read_us ) / rounds << " us per balance read" );
+      return push_us;
+   };
+
+   const auto variant_us = run( "variant",
+      [&]( uint32_t i ) {
+         return push_actions( { make_action( { "alice"_n }, "transfer"_n, mvo()
+                                   ( "from", "alice")( "to", "bob")( "quantity", quantity)( "memo", std::to_string(i)) ) },
+                              { "alice"_n } );
+      },
+      [&]{ get_account( "bob"_n, "4,TKN" ); } );
+
+   const auto raw_us = run( "raw",
+      [&]( uint32_t i ) {
+         return push_raw( token_raw::transfer{ "alice"_n, "bob"_n, quantity, std::to_string(i) } );
+      },
+      [&]{ get_account_raw( "bob"_n, sym ); } );
+   produce_block();
+
+   // both paths agree on the rows
+   const auto bob = get_account_raw( "bob"_n, sym );
+   BOOST_REQUIRE( bob );
+   BOOST_REQUIRE_EQUAL( get_account( "bob"_n, "4,TKN" )["balance"].as_string(), bob->balance.to_string() );
+   BOOST_REQUIRE_EQUAL( asset( ( 2 * rounds + 1 ) * 10000, sym ).to_string(), bob->balance.to_string() );
+   BOOST_REQUIRE_EQUAL( get_stats( "4,TKN" )["supply"].as_string(), get_stats_raw( sym )->supply.to_string() );
+   BOOST_TEST_MESSAGE( "raw path pushes in " << double( raw_us ) / variant_us * 100 << "% of the variant path time" );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( host_calls_per_action, eosio_token_tester ) try {
+
+   const std::vector<string> hosts = { "db_find_i64", "db_get_i64", "db_update_i64", "db_store_i64",
+                                       "is_account", "require_recipient", "has_auth" };
+   const auto profiled = wasm_profile::instrument( contracts::token_wasm(), "token", hosts );
+   set_code( "eosio.token"_n, profiled.wasm );
+   produce_block();
+   create_accounts( { "dave"_n } );
+
+   // the most calls of each host function an action may make, a host function left out is not called
+   const auto check = [&]( const string& label, const vector<account_name>& signers, const action_name& name,
+                           const variant_object& data, const std::map<string, uint32_t>& bounds ) {
+      const auto trace = push_actions( { make_action( signers, name, data ) }, signers );
+      produce_block();
+      const auto counts = wasm_profile::counts( trace->action_traces.front().console, profiled );
+      BOOST_REQUIRE_MESSAGE( counts, label << ": the action printed no counts" );
+
+      std::ostringstream calls;
+      for( const auto& [host, usage] : wasm_profile::host_usage( profiled, *counts ) ) {
+         const auto bound = bounds.count( host ) ? bounds.at( host ) : 0;
+         BOOST_CHECK_MESSAGE( usage.calls <= bound, label << ": " << usage.calls << " calls to " << host << ", at most " << bound );
+         calls << " " << host << " " << usage.calls;
+         if( usage.bytes ) calls << " (" << usage.bytes << " bytes)";
+      }
+      BOOST_TEST_MESSAGE( label << ":" << calls.str() );
+   };
+
+   check( "create", { "eosio.token"_n }, "create"_n, mvo()
+      ( "issuer", "alice")( "maximum_supply", "1000000.0000 TKN"),
+      { { "db_find_i64", 1 }, { "db_store_i64", 1 } } );
+   check( "issue", { "alice"_n }, "issue"_n, mvo()
+      ( "to", "alice")( "quantity", "1000.0000 TKN")( "memo", ""),
+      { { "db_find_i64", 2 }, { "db_get_i64", 2 }, { "db_update_i64", 1 }, { "db_store_i64", 1 } } );
+   // the stats, the opt-outs of both parties, the sender's exemption, then the sender, receiver and issuer balances
+   check( "transfer_first_receipt", { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", ""),
+      { { "db_find_i64", 7 }, { "db_get_i64", 6 }, { "db_update_i64", 2 }, { "db_store_i64", 1 },
+        { "is_account", 1 }, { "require_recipient", 2 }, { "has_auth", 1 } } );
+   check( "transfer", { "alice"_n }, "transfer"_n, mvo()
+      ( "from", "alice")( "to", "bob")( "quantity", "1.0000 TKN")( "memo", ""),
+      { { "db_find_i64", 7 }, { "db_get_i64", 8 }, { "db_update_i64", 3 },
+        { "is_account", 1 }, { "require_recipient", 2 }, { "has_auth", 1 } } );
+   check( "open", { "dave"_n }, "open"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN")( "ram_payer", "dave"),
+      { { "db_find_i64", 2 }, { "db_get_i64", 2 }, { "db_store_i64", 1 }, { "is_account", 1 } } );
+   check( "close", { "dave"_n }, "close"_n, mvo()
+      ( "owner", "dave")( "symbol", "4,TKN"),
+      { { "db_find_i64", 1 }, { "db_get_i64", 2 } } );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
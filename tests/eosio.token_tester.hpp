@@ -0,0 +1,505 @@
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+// #include "eosio.system_tester.hpp"
+#include "contracts.hpp"
+#include "sparse_merkle.hpp"
+#include "token_raw.hpp"
+
+#include "Runtime/Runtime.h"
+#include <eosio/chain/snapshot.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace eosio::testing;
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using namespace fc;
+using namespace std;
+
+using mvo = fc::mutable_variant_object;
+
+/**
+ * The chain every test starts from, with `alice`, `bob`, `carol` and the contract set on `eosio.token`.
+ *
+ * Building it from genesis takes most of the time of a short test, so it is built once per process, or once per
+ * CTest run, and every fixture restores it from an in-memory snapshot. With `EOSIO_TOKEN_FRESH_CHAIN=1` every fixture
+ * builds it from genesis instead, as before.
+ */
+struct base_chain {
+   static void build( base_tester& chain ) {
+      chain.produce_blocks( 2 );
+
+      chain.create_accounts( { "alice"_n, "bob"_n, "carol"_n, "eosio.token"_n } );
+      chain.produce_blocks( 2 );
+
+      chain.set_code( "eosio.token"_n, contracts::token_wasm() );
+      chain.set_abi( "eosio.token"_n, contracts::token_abi().data() );
+
+      chain.produce_blocks();
+   }
+
+   static bool fresh() {
+      const char* value = std::getenv( "EOSIO_TOKEN_FRESH_CHAIN" );
+      return value && string( value ) == "1";
+   }
+
+   // shared by the test processes of a CTest run through the file in `EOSIO_TOKEN_SNAPSHOT_DIR`, cleared by the run
+   static const string& snapshot() {
+      static const string snapshot = [] {
+         const char* dir = std::getenv( "EOSIO_TOKEN_SNAPSHOT_DIR" );
+         const fc::path path = dir && *dir ? fc::path( dir ) / "base_chain.bin" : fc::path();
+         if( !path.empty() && fc::exists( path ) ) {
+            string content;
+            fc::read_file_contents( path, content );
+            return content;
+         }
+
+         tester chain;
+         build( chain );
+         // a snapshot cannot be taken with a pending block
+         chain.control->abort_block();
+
+         std::ostringstream out;
+         auto writer = std::make_shared<ostream_snapshot_writer>( out );
+         chain.control->write_snapshot( writer );
+         writer->finalize();
+
+         if( !path.empty() ) {
+            // renamed into place, so that a process starting meanwhile never reads it partly written
+            fc::create_directories( path.parent_path() );
+            const fc::path partial = path.generic_string() + "." + std::to_string( ::getpid() );
+            std::ofstream( partial.generic_string(), std::ios::binary ) << out.str();
+            fc::rename( partial, path );
+         }
+         return out.str();
+      }();
+      return snapshot;
+   }
+};
+
+class eosio_token_tester : public base_tester {
+public:
+
+   eosio_token_tester() {
+      if( base_chain::fresh() ) {
+         init( setup_policy::full );
+         base_chain::build( *this );
+      } else {
+         std::istringstream in( base_chain::snapshot() );
+         init( default_config( tempdir ).first, std::make_shared<istream_snapshot_reader>( in ) );
+      }
+      load_abi();
+   }
+
+   // as `tester` produces them, which cannot start from a snapshot
+   signed_block_ptr produce_block( fc::microseconds skip_time = fc::milliseconds(config::block_interval_ms) )override {
+      return _produce_block( skip_time, false );
+   }
+
+   signed_block_ptr produce_empty_block( fc::microseconds skip_time = fc::milliseconds(config::block_interval_ms) )override {
+      unapplied_transactions.add_aborted( control->abort_block() );
+      return _produce_block( skip_time, true );
+   }
+
+   signed_block_ptr finish_block()override {
+      return _finish_block();
+   }
+
+   bool validate() { return true; }
+
+   void load_abi() {
+      const auto& accnt = control->db().get<account_object,by_name>( "eosio.token"_n );
+      abi_def abi;
+      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
+      abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
+   }
+
+   // deploys the contract built from `wasm` and `abi`, e.g. an older release of eosio.token
+   void deploy( const vector<uint8_t>& wasm, const vector<char>& abi ) {
+      set_code( "eosio.token"_n, wasm );
+      set_abi( "eosio.token"_n, abi.data() );
+      produce_blocks();
+      load_abi();
+   }
+
+   int64_t get_ram_usage( account_name account ) {
+      return control->get_resource_limits_manager().get_account_ram_usage( account );
+   }
+
+   vector<char> get_raw_row( account_name scope, name table, uint64_t primary_key ) {
+      return get_row_by_account( "eosio.token"_n, scope, table, account_name(primary_key) );
+   }
+
+   action_result push_action( const account_name& signer, const action_name &name, const variant_object &data ) {
+      string action_type_name = abi_ser.get_action_type(name);
+
+      action act;
+      act.account = "eosio.token"_n;
+      act.name    = name;
+      act.data    = abi_ser.variant_to_binary( action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+
+      return base_tester::push_action( std::move(act), signer.to_uint64_t() );
+   }
+
+   action_result push_action( const vector<account_name>& signers, const action_name &name, const variant_object &data ) {
+      try {
+         base_tester::push_action( "eosio.token"_n, name, signers, data );
+      } catch( const fc::exception& ex ) {
+         return error( ex.top_message() );
+      }
+      produce_block();
+      return success();
+   }
+
+   transaction_trace_ptr push_actions( vector<action>&& acts, const vector<account_name>& signers ) {
+      signed_transaction trx;
+      for( auto& act : acts ) {
+         trx.actions.emplace_back( std::move(act) );
+      }
+      set_transaction_headers( trx );
+      for( const auto& signer : signers ) {
+         trx.sign( get_private_key( signer, "active" ), control->get_chain_id() );
+      }
+      // billed from the measured CPU time, rather than the fixed time the tester bills by default
+      return push_transaction( trx, fc::time_point::maximum(), 0 );
+   }
+
+   fc::variant return_value( const transaction_trace_ptr& trace, const string& type ) {
+      const auto& data = trace->action_traces.front().return_value;
+      return abi_ser.binary_to_variant( type, data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   action make_action( const vector<account_name>& signers, const action_name &name, const variant_object &data ) {
+      vector<permission_level> auths;
+      for( const auto& signer : signers ) {
+         auths.push_back( permission_level{ signer, config::active_name } );
+      }
+      return get_action( "eosio.token"_n, name, auths, data );
+   }
+
+   // pushes `args` packed as they are, rather than through a variant and the ABI, for load tests
+   template<typename Args>
+   transaction_trace_ptr push_raw( const Args& args ) {
+      const auto signer = args.signer();
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{ { signer, config::active_name } }, "eosio.token"_n,
+                                Args::action_name, fc::raw::pack( args ) );
+      // the expiration varies so that repeated actions are distinct transactions
+      set_transaction_headers( trx, 60 + raw_sequence++ % 3000 );
+
+      auto key = raw_keys.find( signer );
+      if( key == raw_keys.end() ) {
+         key = raw_keys.emplace( signer, get_private_key( signer, "active" ) ).first;
+      }
+      trx.sign( key->second, control->get_chain_id() );
+      return push_transaction( trx, fc::time_point::maximum(), 0 );
+   }
+
+   std::optional<token_raw::account> get_account_raw( account_name acc, const symbol& sym ) {
+      const auto data = get_row_by_account( "eosio.token"_n, acc, "accounts"_n, account_name( sym.to_symbol_code().value ) );
+      if( data.empty() ) return {};
+      return token_raw::account::unpack( data );
+   }
+
+   std::optional<token_raw::currency_stats> get_stats_raw( const symbol& sym ) {
+      const auto code = sym.to_symbol_code().value;
+      const auto data = get_row_by_account( "eosio.token"_n, name( code ), "stat"_n, account_name( code ) );
+      if( data.empty() ) return {};
+      return token_raw::currency_stats::unpack( data );
+   }
+
+   fc::variant get_stats( const string& symbolname )
+   {
+      auto symb = eosio::chain::symbol::from_string(symbolname);
+      auto symbol_code = symb.to_symbol_code().value;
+      vector<char> data = get_row_by_account( "eosio.token"_n, name(symbol_code), "stat"_n, account_name(symbol_code) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "currency_stats", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_account( account_name acc, const string& symbolname)
+   {
+      auto symb = eosio::chain::symbol::from_string(symbolname);
+      auto symbol_code = symb.to_symbol_code().value;
+      vector<char> data = get_row_by_account( "eosio.token"_n, acc, "accounts"_n, account_name(symbol_code) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   fc::variant get_subaccount( account_name owner, uint64_t id )
+   {
+      vector<char> data = get_row_by_account( "eosio.token"_n, owner, "subaccounts"_n, account_name(id) );
+      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "subaccount", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
+   }
+
+   action_result create( account_name issuer,
+                         asset        maximum_supply ) {
+
+      return push_action( "eosio.token"_n, "create"_n, mvo()
+           ( "issuer", issuer)
+           ( "maximum_supply", maximum_supply)
+      );
+   }
+
+   action_result issue( account_name issuer, asset quantity, string memo ) {
+      return push_action( issuer, "issue"_n, mvo()
+           ( "to", issuer)
+           ( "quantity", quantity)
+           ( "memo", memo)
+      );
+   }
+
+   action_result retire( account_name issuer, asset quantity, string memo ) {
+      return push_action( issuer, "retire"_n, mvo()
+           ( "quantity", quantity)
+           ( "memo", memo)
+      );
+
+   }
+
+   action_result transfer( account_name from,
+                  account_name to,
+                  asset        quantity,
+                  string       memo ) {
+      return push_action( from, "transfer"_n, mvo()
+           ( "from", from)
+           ( "to", to)
+           ( "quantity", quantity)
+           ( "memo", memo)
+      );
+   }
+
+   action_result transferid( account_name from,
+                             account_name to,
+                             asset        quantity,
+                             string       memo,
+                             uint64_t     request_id ) {
+      return push_action( from, "transferid"_n, mvo()
+           ( "from", from)
+           ( "to", to)
+           ( "quantity", quantity)
+           ( "memo", memo)
+           ( "request_id", request_id)
+      );
+   }
+
+   action_result xfer( account_name from,
+                       account_name to,
+                       uint64_t     amount,
+                       const string& sym,
+                       uint64_t     tag ) {
+      return push_action( from, "xfer"_n, mvo()
+           ( "from", from)
+           ( "to", to)
+           ( "amount", amount)
+           ( "sym", sym)
+           ( "tag", tag)
+      );
+   }
+
+   action_result swap( account_name a,
+                       account_name b,
+                       asset        quantity_a,
+                       asset        quantity_b,
+                       string       memo ) {
+      return push_action( { a, b }, "swap"_n, mvo()
+           ( "a", a)
+           ( "b", b)
+           ( "quantity_a", quantity_a)
+           ( "quantity_b", quantity_b)
+           ( "memo", memo)
+      );
+   }
+
+   action_result subdeposit( account_name owner, uint64_t subaccount, asset quantity ) {
+      return push_action( owner, "subdeposit"_n, mvo()
+           ( "owner", owner )
+           ( "subaccount", subaccount )
+           ( "quantity", quantity )
+      );
+   }
+
+   action_result subwithdraw( account_name owner, uint64_t subaccount, asset quantity ) {
+      return push_action( owner, "subwithdraw"_n, mvo()
+           ( "owner", owner )
+           ( "subaccount", subaccount )
+           ( "quantity", quantity )
+      );
+   }
+
+   action_result submove( account_name owner, uint64_t from, uint64_t to, asset quantity ) {
+      return push_action( owner, "submove"_n, mvo()
+           ( "owner", owner )
+           ( "from", from )
+           ( "to", to )
+           ( "quantity", quantity )
+      );
+   }
+
+   action_result migrate( account_name payer, const string& symbol, const vector<account_name>& owners ) {
+      return push_action( payer, "migrate"_n, mvo()
+           ( "payer", payer )
+           ( "symbol", symbol )
+           ( "owners", owners )
+      );
+   }
+
+   action_result open( account_name owner,
+                       const string& symbolname,
+                       account_name ram_payer    ) {
+      return push_action( ram_payer, "open"_n, mvo()
+           ( "owner", owner )
+           ( "symbol", symbolname )
+           ( "ram_payer", ram_payer )
+      );
+   }
+
+   action_result openbatch( const vector<account_name>& owners, const string& symbolname, account_name ram_payer ) {
+      return push_action( ram_payer, "openbatch"_n, mvo()
+           ( "owners", owners )
+           ( "symbol", symbolname )
+           ( "ram_payer", ram_payer )
+      );
+   }
+
+   action_result close( account_name owner,
+                        const string& symbolname ) {
+      return push_action( owner, "close"_n, mvo()
+           ( "owner", owner )
+           ( "symbol", "0,CERO" )
+      );
+   }
+
+   action_result freeze( account_name issuer, account_name account, const string& symbol, bool status ) {
+      return push_action( issuer, "freeze"_n, mvo()
+           ( "account", account )
+           ( "symbol", symbol )
+           ( "status", status )
+      );
+   }
+
+   action_result allowsweep( account_name owner, const string& symbol, bool allow ) {
+      return push_action( owner, "allowsweep"_n, mvo()
+           ( "owner", owner )
+           ( "symbol", symbol )
+           ( "allow", allow )
+      );
+   }
+
+   action_result setsweep( account_name issuer, const string& symbol, uint32_t horizon_sec ) {
+      return push_action( issuer, "setsweep"_n, mvo()
+           ( "symbol", symbol )
+           ( "horizon_sec", horizon_sec )
+      );
+   }
+
+   action_result nominate( account_name payer, account_name owner, const string& symbol ) {
+      return push_action( payer, "nominate"_n, mvo()
+           ( "payer", payer )
+           ( "owner", owner )
+           ( "symbol", symbol )
+      );
+   }
+
+   // returns the cursor to resume from
+   uint64_t sweep( const string& symbol, uint64_t cursor, uint32_t limit ) {
+      auto trace = base_tester::push_action( "eosio.token"_n, "sweep"_n, "alice"_n, mvo()
+           ( "symbol", symbol )
+           ( "cursor", cursor )
+           ( "limit", limit )
+      );
+      produce_block();
+      return return_value( trace, "uint64" ).as_uint64();
+   }
+
+   action_result setnotify( account_name account, bool notify ) {
+      return push_action( account, "setnotify"_n, mvo()
+           ( "account", account )
+           ( "notify", notify )
+      );
+   }
+
+   action_result enablemerkle( account_name issuer, const string& symbol ) {
+      return push_action( issuer, "enablemerkle"_n, mvo()
+           ( "symbol", symbol )
+      );
+   }
+
+   static mvo proof_variant( const sparse_merkle::compressed_proof& proof ) {
+      return mvo()
+           ( "bitmap", proof.bitmap )
+           ( "siblings", proof.siblings );
+   }
+
+   action_result hibernate( account_name issuer, account_name owner, const asset& hibernated,
+                            const sparse_merkle::compressed_proof& proof ) {
+      return push_action( issuer, "hibernate"_n, mvo()
+           ( "owner", owner )
+           ( "hibernated", hibernated )
+           ( "proof", proof_variant( proof ) )
+      );
+   }
+
+   action_result restore( account_name ram_payer, account_name owner, const asset& hibernated,
+                          const sparse_merkle::compressed_proof& proof ) {
+      return push_action( ram_payer, "restore"_n, mvo()
+           ( "owner", owner )
+           ( "hibernated", hibernated )
+           ( "ram_payer", ram_payer )
+           ( "proof", proof_variant( proof ) )
+      );
+   }
+
+   // every inner node of the balance tree of `symbolname`, decoded from the `smtnodes` table
+   sparse_merkle::compact::nodes get_merkle_nodes( const string& symbolname ) {
+      const auto symbol_code = eosio::chain::symbol::from_string(symbolname).to_symbol_code().value;
+      const auto& db = control->db();
+      const auto* t_id = db.find<table_id_object, by_code_scope_table>( boost::make_tuple( "eosio.token"_n, name(symbol_code), "smtnodes"_n ) );
+
+      sparse_merkle::compact::nodes nodes;
+      if( !t_id ) return nodes;
+
+      const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+      for( auto itr = idx.lower_bound( boost::make_tuple( t_id->id, 0 ) ); itr != idx.end() && itr->t_id == t_id->id; ++itr ) {
+         fc::datastream<const char*> ds( itr->value.data(), itr->value.size() );
+         uint64_t key;
+         sparse_merkle::compact::node n;
+         fc::raw::unpack( ds, key );
+         fc::raw::unpack( ds, n.left );
+         fc::raw::unpack( ds, n.right );
+         fc::raw::unpack( ds, n.left_owner );
+         fc::raw::unpack( ds, n.right_owner );
+         nodes.emplace( key, n );
+      }
+      return nodes;
+   }
+
+   // `count` distinct account names made of `prefix` followed by a base-31 suffix, e.g. holder11111, holder11112...
+   static vector<account_name> make_names( const string& prefix, uint32_t count ) {
+      static const char charmap[] = "12345abcdefghijklmnopqrstuvwxyz";
+      const size_t suffix_len = 12 - prefix.size();
+
+      vector<account_name> names;
+      names.reserve( count );
+      for( uint32_t i = 0; i < count; ++i ) {
+         string suffix( suffix_len, '1' );
+         for( uint32_t n = i, pos = suffix_len; n > 0 && pos > 0; n /= 31 ) {
+            suffix[--pos] = charmap[n % 31];
+         }
+         names.emplace_back( prefix + suffix );
+      }
+      return names;
+   }
+
+   abi_serializer abi_ser;
+   uint32_t raw_sequence = 0;
+   std::map<account_name, fc::crypto::private_key> raw_keys;
+};
@@ -1,125 +1,4 @@
-#include <boost/test/unit_test.hpp>
-#include <eosio/testing/tester.hpp>
-#include <eosio/chain/abi_serializer.hpp>
-// #include "eosio.system_tester.hpp"
-#include "contracts.hpp"
-
-#include "Runtime/Runtime.h"
-#include <fc/variant_object.hpp>
-
-using namespace eosio::testing;
-using namespace eosio;
-using namespace eosio::chain;
-using namespace eosio::testing;
-using namespace fc;
-using namespace std;
-
-using mvo = fc::mutable_variant_object;
-
-class eosio_token_tester : public tester {
-public:
-
-   eosio_token_tester() {
-      produce_blocks( 2 );
-
-      create_accounts( { "alice"_n, "bob"_n, "carol"_n, "eosio.token"_n } );
-      produce_blocks( 2 );
-
-      set_code( "eosio.token"_n, contracts::token_wasm() );
-      set_abi( "eosio.token"_n, contracts::token_abi().data() );
-
-      produce_blocks();
-
-      const auto& accnt = control->db().get<account_object,by_name>( "eosio.token"_n );
-      abi_def abi;
-      BOOST_REQUIRE_EQUAL(abi_serializer::to_abi(accnt.abi, abi), true);
-      abi_ser.set_abi(abi, abi_serializer::create_yield_function(abi_serializer_max_time));
-   }
-
-   action_result push_action( const account_name& signer, const action_name &name, const variant_object &data ) {
-      string action_type_name = abi_ser.get_action_type(name);
-
-      action act;
-      act.account = "eosio.token"_n;
-      act.name    = name;
-      act.data    = abi_ser.variant_to_binary( action_type_name, data, abi_serializer::create_yield_function(abi_serializer_max_time) );
-
-      return base_tester::push_action( std::move(act), signer.to_uint64_t() );
-   }
-
-   fc::variant get_stats( const string& symbolname )
-   {
-      auto symb = eosio::chain::symbol::from_string(symbolname);
-      auto symbol_code = symb.to_symbol_code().value;
-      vector<char> data = get_row_by_account( "eosio.token"_n, name(symbol_code), "stat"_n, account_name(symbol_code) );
-      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "currency_stats", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
-   }
-
-   fc::variant get_account( account_name acc, const string& symbolname)
-   {
-      auto symb = eosio::chain::symbol::from_string(symbolname);
-      auto symbol_code = symb.to_symbol_code().value;
-      vector<char> data = get_row_by_account( "eosio.token"_n, acc, "accounts"_n, account_name(symbol_code) );
-      return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer::create_yield_function(abi_serializer_max_time) );
-   }
-
-   action_result create( account_name issuer,
-                         asset        maximum_supply ) {
-
-      return push_action( "eosio.token"_n, "create"_n, mvo()
-           ( "issuer", issuer)
-           ( "maximum_supply", maximum_supply)
-      );
-   }
-
-   action_result issue( account_name issuer, asset quantity, string memo ) {
-      return push_action( issuer, "issue"_n, mvo()
-           ( "to", issuer)
-           ( "quantity", quantity)
-           ( "memo", memo)
-      );
-   }
-
-   action_result retire( account_name issuer, asset quantity, string memo ) {
-      return push_action( issuer, "retire"_n, mvo()
-           ( "quantity", quantity)
-           ( "memo", memo)
-      );
-
-   }
-
-   action_result transfer( account_name from,
-                  account_name to,
-                  asset        quantity,
-                  string       memo ) {
-      return push_action( from, "transfer"_n, mvo()
-           ( "from", from)
-           ( "to", to)
-           ( "quantity", quantity)
-           ( "memo", memo)
-      );
-   }
-
-   action_result open( account_name owner,
-                       const string& symbolname,
-                       account_name ram_payer    ) {
-      return push_action( ram_payer, "open"_n, mvo()
-           ( "owner", owner )
-           ( "symbol", symbolname )
-           ( "ram_payer", ram_payer )
-      );
-   }
-
-   action_result close( account_name owner,
-                        const string& symbolname ) {
-      return push_action( owner, "close"_n, mvo()
-           ( "owner", owner )
-           ( "symbol", "0,CERO" )
-      );
-   }
-
-   abi_serializer abi_ser;
-};
+#include "eosio.token_tester.hpp"
 
 BOOST_AUTO_TEST_SUITE(eosio_token_tests)
 
@@ -419,4 +298,650 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE( swap_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000 AAA"));
+   create( "bob"_n, asset::from_string("1000000 BBB"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000000 AAA"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( "bob"_n, asset::from_string("1000000 BBB"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of bob" ),
+      push_action( "alice"_n, "swap"_n, mvo()
+           ( "a", "alice")
+           ( "b", "bob")
+           ( "quantity_a", "100000 AAA")
+           ( "quantity_b", "50000 BBB")
+           ( "memo", "")
+      )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot swap a token for itself" ),
+      swap( "alice"_n, "bob"_n, asset::from_string("100 AAA"), asset::from_string("100 AAA"), "" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must transfer positive quantity" ),
+      swap( "alice"_n, "bob"_n, asset::from_string("100 AAA"), asset::from_string("-100 BBB"), "" )
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+      swap( "alice"_n, "bob"_n, asset::from_string("100 AAA"), asset::from_string("1000000 BBB"), "" )
+   );
+
+   // fees of 0.1% on each leg are paid by the sender and collected by the issuer, who is the sender here
+   BOOST_REQUIRE_EQUAL( success(),
+      swap( "alice"_n, "bob"_n, asset::from_string("100000 AAA"), asset::from_string("50000 BBB"), "otc" )
+   );
+
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,AAA"), mvo()
+      ("balance", "900000 AAA")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,AAA"), mvo()
+      ("balance", "100000 AAA")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,BBB"), mvo()
+      ("balance", "50000 BBB")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,BBB"), mvo()
+      ("balance", "950000 BBB")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( subaccount_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   create( "alice"_n, asset::from_string("1000 UNO"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "hola" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 UNO"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+                        subdeposit( "alice"_n, 7, asset::from_string("1001 CERO") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must deposit positive quantity" ),
+                        subdeposit( "alice"_n, 7, asset::from_string("-1 CERO") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), subdeposit( "alice"_n, 7, asset::from_string("300 CERO") ) );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "700 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_subaccount("alice"_n, 7), mvo()
+      ("id", 7)
+      ("balance", "300 CERO")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "sub-account holds a different token" ),
+                        subdeposit( "alice"_n, 7, asset::from_string("1 UNO") ) );
+
+   BOOST_REQUIRE_EQUAL( success(), submove( "alice"_n, 7, 8, asset::from_string("100 CERO") ) );
+   REQUIRE_MATCHING_OBJECT( get_subaccount("alice"_n, 7), mvo()
+      ("balance", "200 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_subaccount("alice"_n, 8), mvo()
+      ("balance", "100 CERO")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn sub-account balance" ),
+                        submove( "alice"_n, 8, 7, asset::from_string("101 CERO") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no sub-account object found" ),
+                        submove( "alice"_n, 9, 7, asset::from_string("1 CERO") ) );
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+                        push_action( "bob"_n, "submove"_n, mvo()
+                                     ( "owner", "alice" )
+                                     ( "from", 7 )
+                                     ( "to", 8 )
+                                     ( "quantity", "1 CERO" ) ) );
+
+   // draining a sub-account removes its row
+   BOOST_REQUIRE_EQUAL( success(), subwithdraw( "alice"_n, 8, asset::from_string("100 CERO") ) );
+   BOOST_REQUIRE_EQUAL( true, get_subaccount("alice"_n, 8).is_null() );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "800 CERO")
+   );
+
+   auto stats = get_stats("0,CERO");
+   REQUIRE_MATCHING_OBJECT( stats, mvo()
+      ("supply", "1000 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( xfer_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000.000 TKN"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000.000 TKN"), "hola" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), xfer( "alice"_n, "bob"_n, 300000, "TKN", 123456789 ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "3,TKN"), mvo()
+      ("balance", "300.000 TKN")
+   );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "no balance with specified symbol" ),
+                        xfer( "alice"_n, "bob"_n, 1, "NOPE", 0 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "must transfer positive quantity" ),
+                        xfer( "alice"_n, "bob"_n, 0, "TKN", 0 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "overdrawn balance" ),
+                        xfer( "alice"_n, "bob"_n, 700001, "TKN", 0 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "cannot transfer to self" ),
+                        xfer( "alice"_n, "alice"_n, 1, "TKN", 0 ) );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( return_value_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000000 CERO"));
+   produce_blocks(1);
+
+   auto trace = push_actions( { make_action( { "alice"_n }, "issue"_n, mvo()
+                                   ( "to", "alice")
+                                   ( "quantity", "600000 CERO")
+                                   ( "memo", "") ) },
+                              { "alice"_n } );
+   BOOST_REQUIRE_EQUAL( "600000 CERO", return_value( trace, "asset" ).as_string() );
+
+   // the issuer sends and collects the fee, so its balance is unchanged by the fee
+   trace = push_actions( { make_action( { "alice"_n }, "transfer"_n, mvo()
+                              ( "from", "alice")
+                              ( "to", "bob")
+                              ( "quantity", "100000 CERO")
+                              ( "memo", "") ) },
+                         { "alice"_n } );
+   REQUIRE_MATCHING_OBJECT( return_value( trace, "transfer_result" ), mvo()
+      ("fee", "100 CERO")
+      ("fee_payer", "alice")
+      ("from_balance", "500000 CERO")
+      ("to_balance", "100000 CERO")
+   );
+   produce_block();
+
+   trace = push_actions( { make_action( { "bob"_n }, "transfer"_n, mvo()
+                              ( "from", "bob")
+                              ( "to", "carol")
+                              ( "quantity", "50000 CERO")
+                              ( "memo", "") ) },
+                         { "bob"_n } );
+   REQUIRE_MATCHING_OBJECT( return_value( trace, "transfer_result" ), mvo()
+      ("fee", "50 CERO")
+      ("fee_payer", "bob")
+      ("from_balance", "49950 CERO")
+      ("to_balance", "50000 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "0,CERO"), mvo()
+      ("balance", "500050 CERO")
+   );
+
+   trace = push_actions( { make_action( { "alice"_n }, "retire"_n, mvo()
+                              ( "quantity", "1000 CERO")
+                              ( "memo", "") ) },
+                         { "alice"_n } );
+   BOOST_REQUIRE_EQUAL( "599000 CERO", return_value( trace, "asset" ).as_string() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( query_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000.000 TKN"));
+   create( "bob"_n, asset::from_string("1000 CERO"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000.000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), issue( "bob"_n, asset::from_string("500 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "carol"_n, asset::from_string("10.000 TKN"), "" ) );
+
+   const vector<account_name> owners{ "alice"_n, "bob"_n, "carol"_n };
+   const vector<string> symbols{ "3,TKN", "0,CERO", "4,NONE" };
+
+   auto trace = base_tester::push_action( "eosio.token"_n, "getbalances"_n, "carol"_n, mvo()
+                                          ( "owners", owners )
+                                          ( "sym_codes", vector<string>{ "TKN", "CERO", "NONE" } ) );
+   auto balances = return_value( trace, "owner_balance[]" ).get_array();
+
+   size_t i = 0;
+   for( const auto& owner : owners ) {
+      for( const auto& sym : symbols ) {
+         auto row = get_account( owner, sym );
+         if( row.is_null() ) continue;
+         BOOST_REQUIRE( i < balances.size() );
+         BOOST_REQUIRE_EQUAL( owner.to_string(), balances[i]["owner"].as_string() );
+         BOOST_REQUIRE_EQUAL( row["balance"].as_string(), balances[i]["balance"].as_string() );
+         ++i;
+      }
+   }
+   BOOST_REQUIRE_EQUAL( i, balances.size() );
+   BOOST_REQUIRE_EQUAL( 3u, balances.size() );
+   produce_block();
+
+   trace = base_tester::push_action( "eosio.token"_n, "getstats"_n, "carol"_n, mvo()
+                                     ( "sym_codes", vector<string>{ "CERO", "NONE", "TKN" } ) );
+   auto stats = return_value( trace, "token_stats[]" ).get_array();
+   BOOST_REQUIRE_EQUAL( 2u, stats.size() );
+   REQUIRE_MATCHING_OBJECT( stats[0], get_stats("0,CERO") );
+   REQUIRE_MATCHING_OBJECT( stats[1], get_stats("3,TKN") );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( versioned_rows_tests, eosio_token_tester ) try {
+
+   const uint64_t tkn = symbol(SY(3, TKN)).to_symbol_code().value;
+
+   // rows written by the release which predates row versions
+   deploy( contracts::token_v1_wasm(), contracts::token_v1_abi() );
+   create( "alice"_n, asset::from_string("1000.000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000.000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), open( "bob"_n, "3,TKN", "alice"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), open( "carol"_n, "3,TKN", "alice"_n ) );
+
+   const size_t v0_account_size = get_raw_row( "alice"_n, "accounts"_n, tkn ).size();
+   const size_t v0_stats_size   = get_raw_row( account_name(tkn), "stat"_n, tkn ).size();
+
+   deploy( contracts::token_wasm(), contracts::token_abi() );
+
+   // old rows decode without a version
+   BOOST_REQUIRE_EQUAL( false, get_account("bob"_n, "3,TKN").get_object().contains("version") );
+   REQUIRE_MATCHING_OBJECT( get_account("alice"_n, "3,TKN"), mvo()
+      ("balance", "1000.000 TKN")
+   );
+
+   // the sender's row is billed to the sender and upgraded, the receiver's row keeps its layout
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("100.000 TKN"), "" ) );
+   // version and last activity
+   BOOST_REQUIRE_EQUAL( v0_account_size + 1 + 4, get_raw_row( "alice"_n, "accounts"_n, tkn ).size() );
+   BOOST_REQUIRE_EQUAL( v0_account_size, get_raw_row( "bob"_n, "accounts"_n, tkn ).size() );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "3,TKN"), mvo()
+      ("balance", "100.000 TKN")
+   );
+
+   // new rows are written in the current layout
+   BOOST_REQUIRE_EQUAL( success(), transfer( "bob"_n, "eosio.token"_n, asset::from_string("1.000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( 2, get_account("eosio.token"_n, "3,TKN")["version"].as_int64() );
+   BOOST_REQUIRE_EQUAL( 2, get_account("bob"_n, "3,TKN")["version"].as_int64() );
+
+   BOOST_REQUIRE_EQUAL( v0_stats_size, get_raw_row( account_name(tkn), "stat"_n, tkn ).size() );
+   BOOST_REQUIRE_EQUAL( success(), retire( "alice"_n, asset::from_string("1.000 TKN"), "" ) );
+   // version, flags, balances root, activity start, hibernated root, hibernated supply and sweep horizon
+   BOOST_REQUIRE_EQUAL( v0_stats_size + 1 + 1 + 32 + 4 + 32 + 16 + 4, get_raw_row( account_name(tkn), "stat"_n, tkn ).size() );
+   REQUIRE_MATCHING_OBJECT( get_stats("3,TKN"), mvo()
+      ("supply", "999.000 TKN")
+      ("version", 4)
+      ("flags", 0)
+      ("hibernated_supply", "0.000 TKN")
+   );
+
+   // background catch-up, sponsored by the issuer
+   BOOST_REQUIRE_EQUAL( false, get_account("carol"_n, "3,TKN").get_object().contains("version") );
+   BOOST_REQUIRE_EQUAL( success(), migrate( "alice"_n, "TKN", { "bob"_n, "carol"_n, "nobody"_n } ) );
+   BOOST_REQUIRE_EQUAL( 2, get_account("carol"_n, "3,TKN")["version"].as_int64() );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "3,TKN"), mvo()
+      ("balance", "0.000 TKN")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( transferid_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   produce_blocks(1);
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+
+   BOOST_REQUIRE_EQUAL( success(), transferid( "alice"_n, "bob"_n, asset::from_string("10 CERO"), "payout", 42 ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "duplicate transfer request id" ),
+                        transferid( "alice"_n, "bob"_n, asset::from_string("10 CERO"), "payout retry", 42 ) );
+   BOOST_REQUIRE_EQUAL( success(), transferid( "alice"_n, "bob"_n, asset::from_string("10 CERO"), "payout", 43 ) );
+
+   // ids are per sender
+   BOOST_REQUIRE_EQUAL( success(), transferid( "bob"_n, "carol"_n, asset::from_string("5 CERO"), "", 42 ) );
+
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "15 CERO")
+   );
+   BOOST_REQUIRE_EQUAL( false, get_raw_row( "alice"_n, "transferids"_n, 42 ).empty() );
+
+   // once the window has passed the id can be used again, and expired ids are pruned
+   produce_block( fc::seconds( 24 * 3600 ) );
+   BOOST_REQUIRE_EQUAL( success(), transferid( "alice"_n, "bob"_n, asset::from_string("10 CERO"), "payout", 42 ) );
+   BOOST_REQUIRE_EQUAL( true, get_raw_row( "alice"_n, "transferids"_n, 43 ).empty() );
+
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "25 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( merkle_commitment_tests, eosio_token_tester ) try {
+
+   const vector<account_name> holders = { "alice"_n, "bob"_n, "carol"_n };
+
+   auto balance_of = [&]( uint64_t owner ) {
+      const auto row = get_account( name( owner ), "0,CERO" );
+      return row.is_null() ? int64_t(0) : row["balance"].as<asset>().get_amount();
+   };
+
+   // compares the committed root with a tree rebuilt from the balance rows, and proves every holder against it
+   auto check_commitment = [&]() {
+      sparse_merkle::compact::tree tree;
+      for( const auto& holder : holders ) {
+         tree.set( holder.to_uint64_t(), balance_of( holder.to_uint64_t() ) );
+      }
+      const auto root = get_stats("0,CERO")["balances_root"].as<fc::sha256>();
+      BOOST_REQUIRE_EQUAL( tree.root().str(), root.str() );
+
+      const auto nodes = get_merkle_nodes("0,CERO");
+      for( const auto& holder : holders ) {
+         const auto expected = tree.prove( holder.to_uint64_t() );
+         const auto proof = sparse_merkle::compact::prove( nodes, holder.to_uint64_t(), expected.amount, balance_of );
+         BOOST_REQUIRE( sparse_merkle::compact::verify( root, proof ) );
+         BOOST_REQUIRE( proof.siblings == expected.siblings );
+         BOOST_REQUIRE_EQUAL( proof.other_owner, expected.other_owner );
+         BOOST_REQUIRE_EQUAL( proof.other_amount, expected.other_amount );
+      }
+      return root;
+   };
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   produce_blocks(1);
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), enablemerkle( "bob"_n, "0,CERO" ) );
+   BOOST_REQUIRE_EQUAL( success(), enablemerkle( "alice"_n, "0,CERO" ) );
+   REQUIRE_MATCHING_OBJECT( get_stats("0,CERO"), mvo()
+      ("flags", 1)
+      ("balances_root", fc::sha256().str())
+   );
+
+   // the authorizer of each action pays for the nodes it adds, not the contract
+   const auto contract_ram = get_ram_usage( "eosio.token"_n );
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balance commitments can only be enabled before tokens are issued" ),
+                        enablemerkle( "alice"_n, "0,CERO" ) );
+   check_commitment();
+
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("300 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "bob"_n, "carol"_n, asset::from_string("100 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), subdeposit( "carol"_n, 1, asset::from_string("40 CERO") ) );
+   const auto root = check_commitment();
+   BOOST_REQUIRE_EQUAL( contract_ram, get_ram_usage( "eosio.token"_n ) );
+
+   // a wrong amount, or a balance claimed by a non-holder, does not verify
+   const auto nodes = get_merkle_nodes("0,CERO");
+   BOOST_REQUIRE( !sparse_merkle::compact::verify( root, sparse_merkle::compact::prove( nodes, "bob"_n.to_uint64_t(), 201, balance_of ) ) );
+   BOOST_REQUIRE( !sparse_merkle::compact::verify( root, sparse_merkle::compact::prove( nodes, "dave"_n.to_uint64_t(), 1, balance_of ) ) );
+   // dave's place holds carol's leaf, which proves that dave holds nothing
+   const auto dave = sparse_merkle::compact::prove( nodes, "dave"_n.to_uint64_t(), 0, balance_of );
+   BOOST_REQUIRE_EQUAL( "carol"_n.to_uint64_t(), dave.other_owner );
+   BOOST_REQUIRE( sparse_merkle::compact::verify( root, dave ) );
+
+   // nor does a zero balance of a holder proved with a leaf which is not the one of another holder in its place
+   const auto bob = sparse_merkle::compact::prove( nodes, "bob"_n.to_uint64_t(), 0, balance_of );
+   auto own_leaf = bob;
+   own_leaf.other_owner  = bob.owner;
+   own_leaf.other_amount = 200;
+   // the hashes alone would accept it
+   BOOST_REQUIRE_EQUAL( root.str(), sparse_merkle::compact::root_of( own_leaf ).str() );
+   BOOST_REQUIRE( !sparse_merkle::compact::verify( root, own_leaf ) );
+   auto forged = bob;
+   forged.other_owner  = "dave"_n.to_uint64_t();
+   forged.other_amount = 200;
+   BOOST_REQUIRE( !sparse_merkle::compact::verify( root, forged ) );
+   // alice and bob share the inner node below level 1, which is no leaf of alice's
+   BOOST_REQUIRE( bob.siblings.size() > 2 );
+   auto inner = bob;
+   inner.siblings.resize( 2 );
+   inner.other_owner  = "alice"_n.to_uint64_t();
+   inner.other_amount = 700;
+   BOOST_REQUIRE( !sparse_merkle::compact::verify( root, inner ) );
+
+   // emptied balances drop out of the tree along with the nodes only they used
+   BOOST_REQUIRE_EQUAL( success(), subwithdraw( "carol"_n, 1, asset::from_string("40 CERO") ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "carol"_n, "alice"_n, asset::from_string("100 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "bob"_n, "alice"_n, asset::from_string("200 CERO"), "" ) );
+   check_commitment();
+   BOOST_REQUIRE_EQUAL( success(), retire( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( fc::sha256().str(), check_commitment().str() );
+   BOOST_REQUIRE_EQUAL( true, get_merkle_nodes("0,CERO").empty() );
+
+   // tokens without commitments keep no tree
+   create( "alice"_n, asset::from_string("1000 TWO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 TWO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("1 TWO"), "" ) );
+   BOOST_REQUIRE_EQUAL( true, get_merkle_nodes("0,TWO").empty() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( hibernate_tests, eosio_token_tester ) try {
+
+   const vector<account_name> holders = { "alice"_n, "bob"_n, "carol"_n };
+   sparse_merkle::tree cold; // kept off chain by the issuer
+
+   // every token is either in a balance row, in sub-account 1 of its holder or in cold storage, and cold storage
+   // matches its root
+   auto check_supply = [&]() {
+      const auto st = get_stats("0,CERO");
+      int64_t total = st["hibernated_supply"].as<asset>().get_amount();
+      for( const auto& holder : holders ) {
+         const auto row = get_account( holder, "0,CERO" );
+         if( !row.is_null() ) total += row["balance"].as<asset>().get_amount();
+         const auto sub = get_subaccount( holder, 1 );
+         if( !sub.is_null() ) total += sub["balance"].as<asset>().get_amount();
+      }
+      BOOST_REQUIRE_EQUAL( st["supply"].as<asset>().get_amount(), total );
+      BOOST_REQUIRE_EQUAL( cold.root().str(), st["hibernated_root"].as<fc::sha256>().str() );
+   };
+   auto cold_proof = [&]( account_name owner ) {
+      return sparse_merkle::compress( cold.prove( owner.to_uint64_t() ) );
+   };
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("100 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "carol"_n, asset::from_string("50 CERO"), "" ) );
+   check_supply();
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balance is not dormant" ),
+                        hibernate( "alice"_n, "bob"_n, asset::from_string("0 CERO"), cold_proof( "bob"_n ) ) );
+
+   produce_block( fc::seconds( 365 * 24 * 3600 ) );
+   // carol is still active
+   BOOST_REQUIRE_EQUAL( success(), transfer( "carol"_n, "alice"_n, asset::from_string("1 CERO"), "" ) );
+
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ),
+                        hibernate( "bob"_n, "bob"_n, asset::from_string("0 CERO"), cold_proof( "bob"_n ) ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "invalid proof of the hibernated balance" ),
+                        hibernate( "alice"_n, "bob"_n, asset::from_string("7 CERO"), cold_proof( "bob"_n ) ) );
+
+   // the row is erased and its RAM refunded to alice, who paid for it
+   const auto ram = get_ram_usage( "alice"_n );
+   BOOST_REQUIRE_EQUAL( success(), hibernate( "alice"_n, "bob"_n, asset::from_string("0 CERO"), cold_proof( "bob"_n ) ) );
+   BOOST_REQUIRE( get_ram_usage( "alice"_n ) < ram );
+   BOOST_REQUIRE_EQUAL( true, get_account( "bob"_n, "0,CERO" ).is_null() );
+   cold.set( "bob"_n.to_uint64_t(), 100 );
+   check_supply();
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balance is not dormant" ),
+                        hibernate( "alice"_n, "carol"_n, asset::from_string("0 CERO"), cold_proof( "carol"_n ) ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze( "alice"_n, "alice"_n, "0,CERO", true ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "frozen balances cannot hibernate" ),
+                        hibernate( "alice"_n, "alice"_n, asset::from_string("0 CERO"), cold_proof( "alice"_n ) ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze( "alice"_n, "alice"_n, "0,CERO", false ) );
+
+   // bob receives while hibernated, then restores on top of the new row
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("10 CERO"), "" ) );
+   check_supply();
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "invalid proof of the hibernated balance" ),
+                        restore( "carol"_n, "bob"_n, asset::from_string("99 CERO"), cold_proof( "bob"_n ) ) );
+   const auto proof = cold_proof( "bob"_n );
+   BOOST_REQUIRE_EQUAL( success(), restore( "carol"_n, "bob"_n, asset::from_string("100 CERO"), proof ) );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "110 CERO")
+   );
+   cold.set( "bob"_n.to_uint64_t(), 0 );
+   check_supply();
+
+   // a proof cannot be replayed
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "invalid proof of the hibernated balance" ),
+                        restore( "carol"_n, "bob"_n, asset::from_string("100 CERO"), proof ) );
+
+   // sub-account funds are in neither the balance row nor the cold tree, so they keep the row out of cold storage
+   BOOST_REQUIRE_EQUAL( success(), subdeposit( "bob"_n, 1, asset::from_string("10 CERO") ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balances with sub-account funds cannot hibernate" ),
+                        hibernate( "alice"_n, "bob"_n, asset::from_string("0 CERO"), cold_proof( "bob"_n ) ) );
+   check_supply();
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( hot_contract_tests, eosio_token_tester ) try {
+
+   if( !contracts::token_hot_built ) {
+      BOOST_TEST_MESSAGE( "skipped, eosio.token.hot is only built with BUILD_HOT_CONTRACT=ON" );
+      return;
+   }
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+   auto issue_act = make_action( { "alice"_n }, "issue"_n, mvo()
+                                    ( "to", "alice")
+                                    ( "quantity", "1 CERO")
+                                    ( "memo", "") );
+
+   deploy( contracts::token_hot_wasm(), contracts::token_hot_abi() );
+   BOOST_REQUIRE_EQUAL( "", abi_ser.get_action_type( "issue"_n ) );
+
+   // the hot contract works on the rows written by the full one
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("300 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), open( "carol"_n, "0,CERO", "alice"_n ) );
+   BOOST_REQUIRE_EQUAL( success(), close( "carol"_n, "0,CERO" ) );
+   BOOST_REQUIRE_THROW( push_actions( { std::move(issue_act) }, { "alice"_n } ), fc::exception );
+
+   // and the full contract reads the rows written by the hot one
+   deploy( contracts::token_wasm(), contracts::token_abi() );
+   BOOST_REQUIRE_EQUAL( success(), retire( "alice"_n, asset::from_string("700 CERO"), "" ) );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "0,CERO"), mvo()
+      ("balance", "300 CERO")
+   );
+   REQUIRE_MATCHING_OBJECT( get_stats("0,CERO"), mvo()
+      ("supply", "300 CERO")
+   );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( sweep_tests, eosio_token_tester ) try {
+
+   create_accounts( { "dave"_n, "erin"_n } );
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+   for( auto owner : { "bob"_n, "carol"_n, "dave"_n, "erin"_n } ) {
+      BOOST_REQUIRE_EQUAL( success(), open( owner, "0,CERO", "alice"_n ) );
+   }
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "carol"_n, asset::from_string("5 CERO"), "" ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "sweeping inactive balances is not enabled for this token" ),
+                        nominate( "alice"_n, "dave"_n, "CERO" ) );
+
+   // owners opt in, bob's empty row goes with the first sweep and refunds alice
+   BOOST_REQUIRE_EQUAL( success(), allowsweep( "bob"_n, "CERO", true ) );
+   BOOST_REQUIRE_EQUAL( success(), allowsweep( "carol"_n, "CERO", true ) );
+   BOOST_REQUIRE_EQUAL( success(), allowsweep( "erin"_n, "CERO", true ) );
+   BOOST_REQUIRE_EQUAL( success(), freeze( "alice"_n, "erin"_n, "0,CERO", true ) );
+
+   const auto ram = get_ram_usage( "alice"_n );
+   BOOST_REQUIRE_EQUAL( 0, sweep( "CERO", 0, 10 ) );
+   BOOST_REQUIRE_EQUAL( true, get_account( "bob"_n, "0,CERO" ).is_null() );
+   BOOST_REQUIRE( get_ram_usage( "alice"_n ) < ram );
+   // carol holds tokens and erin is frozen
+   BOOST_REQUIRE_EQUAL( false, get_account( "carol"_n, "0,CERO" ).is_null() );
+   BOOST_REQUIRE_EQUAL( false, get_account( "erin"_n, "0,CERO" ).is_null() );
+
+   // carol stays listed while she holds tokens, in her balance row or in a sub-account, and is swept once empty
+   BOOST_REQUIRE_EQUAL( success(), subdeposit( "carol"_n, 1, asset::from_string("5 CERO") ) );
+   BOOST_REQUIRE_EQUAL( 0, sweep( "CERO", 0, 10 ) );
+   BOOST_REQUIRE_EQUAL( false, get_account( "carol"_n, "0,CERO" ).is_null() );
+   BOOST_REQUIRE_EQUAL( success(), subwithdraw( "carol"_n, 1, asset::from_string("5 CERO") ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "carol"_n, "alice"_n, asset::from_string("5 CERO"), "" ) );
+   BOOST_REQUIRE_EQUAL( 0, sweep( "CERO", 0, 10 ) );
+   BOOST_REQUIRE_EQUAL( true, get_account( "carol"_n, "0,CERO" ).is_null() );
+
+   // inactive rows can be nominated once the issuer sets a horizon
+   BOOST_REQUIRE_EQUAL( error( "missing authority of alice" ), setsweep( "bob"_n, "CERO", 3600 ) );
+   BOOST_REQUIRE_EQUAL( success(), setsweep( "alice"_n, "CERO", 3600 ) );
+   BOOST_REQUIRE_EQUAL( success(), nominate( "alice"_n, "dave"_n, "CERO" ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "balance is not zero" ), nominate( "alice"_n, "alice"_n, "CERO" ) );
+   BOOST_REQUIRE_EQUAL( 0, sweep( "CERO", 0, 10 ) );
+   BOOST_REQUIRE_EQUAL( false, get_account( "dave"_n, "0,CERO" ).is_null() );
+
+   produce_block( fc::seconds( 3600 ) );
+   // one entry per call, erin's frozen row stays and the call reports where to resume
+   BOOST_REQUIRE_EQUAL( "erin"_n.to_uint64_t(), sweep( "CERO", 0, 1 ) );
+   BOOST_REQUIRE_EQUAL( true, get_account( "dave"_n, "0,CERO" ).is_null() );
+   BOOST_REQUIRE_EQUAL( 0, sweep( "CERO", "erin"_n.to_uint64_t(), 1 ) );
+   BOOST_REQUIRE_EQUAL( false, get_account( "erin"_n, "0,CERO" ).is_null() );
+
+   BOOST_REQUIRE_EQUAL( success(), allowsweep( "erin"_n, "CERO", false ) );
+   BOOST_REQUIRE_EQUAL( true, get_raw_row( name(symbol(SY(0, CERO)).to_symbol_code().value), "sweepcands"_n, "erin"_n.to_uint64_t() ).empty() );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( openbatch_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000.000 TKN"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000.000 TKN"), "" ) );
+   BOOST_REQUIRE_EQUAL( success(), transfer( "alice"_n, "bob"_n, asset::from_string("10.000 TKN"), "" ) );
+
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol precision mismatch" ),
+                        openbatch( { "carol"_n }, "4,TKN", "alice"_n ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "owner account does not exist" ),
+                        openbatch( { "carol"_n, "nonexistent"_n }, "3,TKN", "alice"_n ) );
+
+   // existing rows are left as they are
+   const auto ram = get_ram_usage( "carol"_n );
+   BOOST_REQUIRE_EQUAL( success(), openbatch( { "alice"_n, "bob"_n, "carol"_n, "carol"_n }, "3,TKN", "carol"_n ) );
+   REQUIRE_MATCHING_OBJECT( get_account("bob"_n, "3,TKN"), mvo()
+      ("balance", "10.000 TKN")
+   );
+   REQUIRE_MATCHING_OBJECT( get_account("carol"_n, "3,TKN"), mvo()
+      ("balance", "0.000 TKN")
+   );
+   // carol only paid for her own row
+   const auto row_ram = get_ram_usage( "carol"_n ) - ram;
+   BOOST_REQUIRE_EQUAL( success(), open( "eosio.token"_n, "3,TKN", "carol"_n ) );
+   BOOST_REQUIRE_EQUAL( row_ram, get_ram_usage( "carol"_n ) - ram - row_ram );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( setnotify_tests, eosio_token_tester ) try {
+
+   create( "alice"_n, asset::from_string("1000 CERO"));
+   BOOST_REQUIRE_EQUAL( success(), issue( "alice"_n, asset::from_string("1000 CERO"), "" ) );
+
+   auto transfer_trace = [&]( account_name from, account_name to ) {
+      auto trace = base_tester::push_action( "eosio.token"_n, "transfer"_n, from, mvo()
+                                             ( "from", from)
+                                             ( "to", to)
+                                             ( "quantity", "1 CERO")
+                                             ( "memo", "") );
+      produce_block();
+      return trace;
+   };
+
+   // the action itself and one notification per party
+   BOOST_REQUIRE_EQUAL( 3, transfer_trace( "alice"_n, "bob"_n )->action_traces.size() );
+
+   BOOST_REQUIRE_EQUAL( success(), setnotify( "bob"_n, false ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account is already opted out of notifications" ), setnotify( "bob"_n, false ) );
+   BOOST_REQUIRE_EQUAL( 2, transfer_trace( "alice"_n, "bob"_n )->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( 2, transfer_trace( "bob"_n, "carol"_n )->action_traces.size() );
+
+   BOOST_REQUIRE_EQUAL( success(), setnotify( "carol"_n, false ) );
+   const auto trace = transfer_trace( "bob"_n, "carol"_n );
+   BOOST_REQUIRE_EQUAL( 1, trace->action_traces.size() );
+   BOOST_REQUIRE_EQUAL( "eosio.token"_n, trace->action_traces.front().receiver );
+
+   BOOST_REQUIRE_EQUAL( success(), setnotify( "bob"_n, true ) );
+   BOOST_REQUIRE_EQUAL( wasm_assert_msg( "account is already notified" ), setnotify( "bob"_n, true ) );
+   BOOST_REQUIRE_EQUAL( 2, transfer_trace( "bob"_n, "carol"_n )->action_traces.size() );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
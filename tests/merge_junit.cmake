@@ -0,0 +1,24 @@
+# Merges the JUnit reports written by each test case in JUNIT_DIR into one report at OUTPUT.
+#
+#    cmake -DJUNIT_DIR=<dir> -DOUTPUT=<file> -P merge_junit.cmake
+
+if(NOT JUNIT_DIR OR NOT OUTPUT)
+   message(FATAL_ERROR "usage: cmake -DJUNIT_DIR=<dir> -DOUTPUT=<file> -P merge_junit.cmake")
+endif()
+
+file(GLOB REPORTS "${JUNIT_DIR}/*.xml")
+list(SORT REPORTS)
+
+set(MERGED "")
+foreach(REPORT ${REPORTS})
+   file(READ ${REPORT} CONTENT)
+   # each report is one <testsuite>, or a <testsuites> holding them, after the XML declaration
+   string(REGEX REPLACE "<\\?xml[^>]*\\?>" "" CONTENT "${CONTENT}")
+   string(REGEX REPLACE "</?testsuites[^>]*>" "" CONTENT "${CONTENT}")
+   string(STRIP "${CONTENT}" CONTENT)
+   string(APPEND MERGED "${CONTENT}\n")
+endforeach()
+
+list(LENGTH REPORTS COUNT)
+file(WRITE ${OUTPUT} "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n${MERGED}</testsuites>\n")
+message(STATUS "merged ${COUNT} reports into ${OUTPUT}")
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <fc/crypto/sha256.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <vector>
+
+/**
+ * Native mirror of the sparse Merkle trees of balances which `eosio.token` keeps for tokens with balance commitments.
+ *
+ * The path of an owner is the bits of its name from the most significant one, 1 going right. A leaf is sha256 of
+ * the owner and the balance amount, both as 8 little-endian bytes, and a zero balance is an empty leaf. Empty
+ * subtrees hash to all zeros, so a parent of two empty children is empty and any other parent is sha256 of the
+ * two child hashes.
+ *
+ * The cold tree of hibernated balances, which the issuer keeps off chain, has all its leaves 64 levels below the
+ * root. The tree of live balances, whose nodes the contract stores, is in `compact`.
+ */
+namespace sparse_merkle {
+
+   using fc::sha256;
+
+   constexpr int depth = 64;
+
+   inline sha256 leaf( uint64_t owner, int64_t amount ) {
+      if( amount == 0 ) return sha256();
+
+      char data[16];
+      std::memcpy( data, &owner, 8 );
+      std::memcpy( data + 8, &amount, 8 );
+      return sha256::hash( data, sizeof(data) );
+   }
+
+   inline sha256 parent( const sha256& left, const sha256& right ) {
+      if( left == sha256() && right == sha256() ) return sha256();
+
+      char data[64];
+      std::memcpy( data, left.data(), 32 );
+      std::memcpy( data + 32, right.data(), 32 );
+      return sha256::hash( data, sizeof(data) );
+   }
+
+   inline bool goes_right( uint64_t owner, int level ) {
+      return ( owner >> ( depth - 1 - level ) ) & 1;
+   }
+
+   /// Primary key of the `smtnodes` row of the node at `level` on the path of `owner`, same as the contract.
+   inline uint64_t node_key( uint64_t owner, int level ) {
+      const uint64_t prefix = level == 0 ? 0 : owner & ( ~uint64_t(0) << ( depth - level ) );
+      return prefix | ( uint64_t(1) << ( depth - 1 - level ) );
+   }
+
+   /// Siblings on the path of `owner`, `siblings[level]` is the child of the node at `level` which is not on the path.
+   struct proof {
+      uint64_t                   owner  = 0;
+      int64_t                    amount = 0;
+      std::array<sha256, depth>  siblings;
+   };
+
+   inline sha256 root_of( const proof& p ) {
+      sha256 hash = leaf( p.owner, p.amount );
+      for( int level = depth - 1; level >= 0; --level ) {
+         hash = goes_right( p.owner, level ) ? parent( p.siblings[level], hash ) : parent( hash, p.siblings[level] );
+      }
+      return hash;
+   }
+
+   /// Checks that `owner` holds `amount` under `root`, an amount of 0 proves that `owner` holds no balance.
+   inline bool verify( const sha256& root, const proof& p ) {
+      return root_of( p ) == root;
+   }
+
+   /// The proof as taken by `hibernate` and `restore`, only the non-empty siblings are kept.
+   struct compressed_proof {
+      uint64_t             bitmap = 0;
+      std::vector<sha256>  siblings;
+   };
+
+   inline compressed_proof compress( const proof& p ) {
+      compressed_proof c;
+      for( int level = 0; level < depth; ++level ) {
+         if( p.siblings[level] == sha256() ) continue;
+         c.bitmap |= uint64_t(1) << level;
+         c.siblings.push_back( p.siblings[level] );
+      }
+      return c;
+   }
+
+   /// The cold tree of a set of balances, independent of any on-chain state. The hashes of its non-empty inner
+   /// nodes are kept and updated along the path of each change, so that setting a balance or proving one takes
+   /// one hash or lookup per level.
+   class tree {
+      public:
+         void set( uint64_t owner, int64_t amount ) {
+            if( amount == 0 ) balances.erase( owner );
+            else              balances[owner] = amount;
+
+            sha256 hash = leaf( owner, amount );
+            for( int level = depth - 1; level >= 0; --level ) {
+               const auto sibling = hash_at( owner ^ bit( level ), level + 1 );
+               hash = goes_right( owner, level ) ? parent( sibling, hash ) : parent( hash, sibling );
+               if( hash == sha256() ) nodes.erase( node_key( owner, level ) );
+               else                   nodes[node_key( owner, level )] = hash;
+            }
+         }
+
+         sha256 root()const {
+            return hash_at( 0, 0 );
+         }
+
+         proof prove( uint64_t owner )const {
+            proof p;
+            p.owner = owner;
+            auto it = balances.find( owner );
+            if( it != balances.end() ) p.amount = it->second;
+
+            for( int level = 0; level < depth; ++level ) {
+               p.siblings[level] = hash_at( owner ^ bit( level ), level + 1 );
+            }
+            return p;
+         }
+
+      private:
+         // the bit of a path which chooses between the children of the node at `level`
+         static uint64_t bit( int level ) {
+            return uint64_t(1) << ( depth - 1 - level );
+         }
+
+         // hash of the node at `level` on `path`, the leaf of `path` at the bottom
+         sha256 hash_at( uint64_t path, int level )const {
+            if( level == depth ) {
+               auto it = balances.find( path );
+               return it == balances.end() ? sha256() : leaf( it->first, it->second );
+            }
+            auto it = nodes.find( node_key( path, level ) );
+            return it == nodes.end() ? sha256() : it->second;
+         }
+
+         std::map<uint64_t, int64_t> balances;
+         std::map<uint64_t, sha256>  nodes; // non-empty inner nodes, keyed by `node_key`
+   };
+
+   /**
+    * The tree of live balances. A leaf sits at the first level where the path of its owner parts from every other
+    * holder's rather than at the bottom, so a subtree with a single holder hashes to its leaf. The root is always
+    * the parent of its two children, even with a single holder, and the tree of no balance is empty.
+    */
+   namespace compact {
+
+      /// Inner node as stored on chain, an owner is set when the child next to it is a leaf.
+      struct node {
+         sha256    left, right;
+         uint64_t  left_owner = 0, right_owner = 0;
+      };
+
+      /// Inner nodes as stored on chain, keyed by `node_key`.
+      using nodes = std::map<uint64_t, node>;
+
+      /// Siblings on the path of `owner` from the root down to its leaf, or to the place for it. When that place
+      /// holds the leaf of another owner, `other_owner` and `other_amount` are that leaf, which proves that `owner`
+      /// holds no balance.
+      struct proof {
+         uint64_t             owner  = 0;
+         int64_t              amount = 0;
+         std::vector<sha256>  siblings;
+         uint64_t             other_owner  = 0;
+         int64_t              other_amount = 0;
+      };
+
+      inline sha256 root_of( const proof& p ) {
+         sha256 hash = p.other_owner ? leaf( p.other_owner, p.other_amount ) : leaf( p.owner, p.amount );
+         for( int level = int( p.siblings.size() ) - 1; level >= 0; --level ) {
+            hash = goes_right( p.owner, level ) ? parent( p.siblings[level], hash ) : parent( hash, p.siblings[level] );
+         }
+         return hash;
+      }
+
+      /// Checks that `owner` holds `amount` under `root`, an amount of 0 proves that `owner` holds no balance.
+      inline bool verify( const sha256& root, const proof& p ) {
+         if( p.other_owner ) {
+            // the place of `owner` holds the leaf of another holder, whose path leads to the same place
+            if( p.amount != 0 || p.other_owner == p.owner || p.other_amount == 0 || p.siblings.empty() ) return false;
+            for( size_t level = 0; level < p.siblings.size(); ++level ) {
+               if( goes_right( p.owner, level ) != goes_right( p.other_owner, level ) ) return false;
+            }
+         }
+         return root_of( p ) == root;
+      }
+
+      /// Builds the proof of `owner` from the inner nodes read from chain, `balance_of` gives the balance of the
+      /// holder whose leaf is found in the place of `owner`.
+      template<typename BalanceOf>
+      proof prove( const nodes& tree, uint64_t owner, int64_t amount, BalanceOf&& balance_of ) {
+         proof p;
+         p.owner  = owner;
+         p.amount = amount;
+         for( int level = 0; level < depth; ++level ) {
+            auto it = tree.find( node_key( owner, level ) );
+            if( it == tree.end() ) break;
+
+            const bool right = goes_right( owner, level );
+            const auto& n = it->second;
+            p.siblings.push_back( right ? n.left : n.right );
+
+            const auto& child = right ? n.right : n.left;
+            const auto child_owner = right ? n.right_owner : n.left_owner;
+            if( child == sha256() ) break;
+            if( child_owner != 0 ) {
+               if( child_owner != owner ) {
+                  p.other_owner  = child_owner;
+                  p.other_amount = balance_of( child_owner );
+               }
+               break;
+            }
+         }
+         return p;
+      }
+
+      /// The tree of a set of balances, independent of any on-chain state.
+      class tree {
+         public:
+            void set( uint64_t owner, int64_t amount ) {
+               if( amount == 0 ) balances.erase( owner );
+               else              balances[owner] = amount;
+            }
+
+            sha256 root()const {
+               if( balances.empty() ) return sha256();
+               return inner( balances.begin(), balances.end(), 0 );
+            }
+
+            proof prove( uint64_t owner )const {
+               proof p;
+               p.owner = owner;
+               auto it = balances.find( owner );
+               if( it != balances.end() ) p.amount = it->second;
+               if( balances.empty() ) return p;
+
+               // the root is an inner node, below it the path ends where at most one holder is left
+               auto first = balances.begin(), last = balances.end();
+               for( int level = 0; level == 0 || std::distance( first, last ) > 1; ++level ) {
+                  auto mid = split( first, last, level );
+                  if( goes_right( owner, level ) ) {
+                     p.siblings.push_back( subtree( first, mid, level + 1 ) );
+                     first = mid;
+                  } else {
+                     p.siblings.push_back( subtree( mid, last, level + 1 ) );
+                     last = mid;
+                  }
+               }
+               if( first != last && first->first != owner ) {
+                  p.other_owner  = first->first;
+                  p.other_amount = first->second;
+               }
+               return p;
+            }
+
+         private:
+            using iterator = std::map<uint64_t, int64_t>::const_iterator;
+
+            static iterator split( iterator first, iterator last, int level ) {
+               return std::find_if( first, last, [&]( const auto& b ) { return goes_right( b.first, level ); } );
+            }
+
+            static sha256 inner( iterator first, iterator last, int level ) {
+               auto mid = split( first, last, level );
+               return parent( subtree( first, mid, level + 1 ), subtree( mid, last, level + 1 ) );
+            }
+
+            static sha256 subtree( iterator first, iterator last, int level ) {
+               if( first == last ) return sha256();
+               if( std::next( first ) == last ) return leaf( first->first, first->second );
+               return inner( first, last, level );
+            }
+
+            std::map<uint64_t, int64_t> balances;
+      };
+
+   } /// namespace compact
+
+} /// namespace sparse_merkle
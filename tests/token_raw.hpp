@@ -0,0 +1,130 @@
+#pragma once
+
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/name.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * Native mirrors of the `eosio.token` action arguments and rows, packed and read with `fc::raw`.
+ *
+ * The helpers of `eosio_token_tester` go through a variant and the ABI for every action and row, which costs more
+ * than the contract itself in a load test. These structs have the fields of the ABI in the same order, so packing
+ * them gives the same bytes without either. The rows read their binary extensions only while bytes remain, as the
+ * contract does. Tests of the ABI itself keep the variant helpers.
+ */
+namespace token_raw {
+
+   using eosio::chain::account_name;
+   using eosio::chain::asset;
+   using eosio::chain::symbol;
+   using namespace eosio::chain::literals;
+
+   struct transfer {
+      static constexpr auto action_name = "transfer"_n;
+
+      account_name from;
+      account_name to;
+      asset        quantity;
+      std::string  memo;
+
+      account_name signer()const { return from; }
+   };
+
+   struct issue {
+      static constexpr auto action_name = "issue"_n;
+
+      account_name to;
+      asset        quantity;
+      std::string  memo;
+
+      account_name signer()const { return to; }
+   };
+
+   struct open {
+      static constexpr auto action_name = "open"_n;
+
+      account_name owner;
+      symbol       sym;
+      account_name ram_payer;
+
+      account_name signer()const { return ram_payer; }
+   };
+
+   struct close {
+      static constexpr auto action_name = "close"_n;
+
+      account_name owner;
+      symbol       sym;
+
+      account_name signer()const { return owner; }
+   };
+
+   template<typename T>
+   void unpack_extension( fc::datastream<const char*>& ds, std::optional<T>& field ) {
+      if( ds.remaining() == 0 ) return;
+      T value;
+      fc::raw::unpack( ds, value );
+      field = value;
+   }
+
+   struct account {
+      asset                             balance;
+      bool                              is_frozen = false;
+      std::optional<uint8_t>            version;
+      std::optional<fc::time_point_sec> last_active;
+
+      static account unpack( const std::vector<char>& data ) {
+         fc::datastream<const char*> ds( data.data(), data.size() );
+         account row;
+         fc::raw::unpack( ds, row.balance );
+         fc::raw::unpack( ds, row.is_frozen );
+         unpack_extension( ds, row.version );
+         unpack_extension( ds, row.last_active );
+         return row;
+      }
+   };
+
+   struct currency_stats {
+      asset                             supply;
+      asset                             max_supply;
+      account_name                      issuer;
+      uint8_t                           fees = 0;
+      std::optional<uint8_t>            version;
+      std::optional<uint8_t>            flags;
+      std::optional<fc::sha256>         balances_root;
+      std::optional<fc::time_point_sec> active_since;
+      std::optional<fc::sha256>         hibernated_root;
+      std::optional<asset>              hibernated_supply;
+      std::optional<uint32_t>           sweep_horizon_sec;
+
+      static currency_stats unpack( const std::vector<char>& data ) {
+         fc::datastream<const char*> ds( data.data(), data.size() );
+         currency_stats row;
+         fc::raw::unpack( ds, row.supply );
+         fc::raw::unpack( ds, row.max_supply );
+         fc::raw::unpack( ds, row.issuer );
+         fc::raw::unpack( ds, row.fees );
+         unpack_extension( ds, row.version );
+         unpack_extension( ds, row.flags );
+         unpack_extension( ds, row.balances_root );
+         unpack_extension( ds, row.active_since );
+         unpack_extension( ds, row.hibernated_root );
+         unpack_extension( ds, row.hibernated_supply );
+         unpack_extension( ds, row.sweep_horizon_sec );
+         return row;
+      }
+   };
+
+} /// namespace token_raw
+
+FC_REFLECT( token_raw::transfer, (from)(to)(quantity)(memo) )
+FC_REFLECT( token_raw::issue, (to)(quantity)(memo) )
+FC_REFLECT( token_raw::open, (owner)(sym)(ram_payer) )
+FC_REFLECT( token_raw::close, (owner)(sym) )
@@ -0,0 +1,138 @@
+/**
+ * Builds the cold storage commitments of one token from a state export, for the `hibernate` and `restore` actions.
+ *
+ *    cold_commit [--ram-payer <account>] <state.json>
+ *
+ * The input lists the balances already in cold storage, as written by the previous run, the dormant balance rows
+ * to hibernate, e.g. exported from the `accounts` tables, and the owners to restore:
+ *
+ *    { "symbol": "4,TKN",
+ *      "hibernated": [ { "owner": "bob", "balance": "1.0000 TKN" } ],
+ *      "hibernate":  [ { "owner": "carol", "balance": "2.0000 TKN" } ],
+ *      "restore":    [ "bob" ] }
+ *
+ * The output holds the actions to push, in order since every proof is against the root left by the previous one,
+ * and the resulting cold storage, root and supply, to be kept as the input of the next run. The balance rows brought
+ * back by `restore` are billed to `--ram-payer`, each owner by default, which then has to authorize its action.
+ */
+#include "sparse_merkle.hpp"
+
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/name.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <iostream>
+#include <string>
+
+using eosio::chain::asset;
+using eosio::chain::name;
+using eosio::chain::symbol;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   fc::variant proof_variant( const sparse_merkle::compressed_proof& proof ) {
+      return mvo()
+         ( "bitmap", proof.bitmap )
+         ( "siblings", proof.siblings );
+   }
+
+   fc::variant action_variant( const char* action, const mvo& data ) {
+      return mvo()
+         ( "account", "eosio.token" )
+         ( "name", action )
+         ( "data", data );
+   }
+
+}
+
+int main( int argc, char** argv ) {
+   std::string state_path, ram_payer;
+   bool invalid = false;
+   for( int i = 1; i < argc; ++i ) {
+      const std::string arg = argv[i];
+      if( arg == "--ram-payer" && i + 1 < argc ) ram_payer = argv[++i];
+      else if( arg.rfind( "--", 0 ) != 0 && state_path.empty() ) state_path = arg;
+      else invalid = true;
+   }
+   if( invalid || state_path.empty() ) {
+      std::cerr << "usage: " << argv[0] << " [--ram-payer <account>] <state.json>\n";
+      return 1;
+   }
+
+   try {
+      const auto state = fc::json::from_file( state_path ).get_object();
+      const auto sym = symbol::from_string( state["symbol"].as_string() );
+
+      sparse_merkle::tree cold;
+      std::map<name, int64_t> hibernated;
+      auto read_balance = [&]( const fc::variant& entry ) {
+         const auto balance = asset::from_string( entry["balance"].as_string() );
+         EOS_ASSERT( balance.get_symbol() == sym, eosio::chain::asset_type_exception,
+                     "balance ${b} is not in ${s}", ("b", balance)("s", sym) );
+         return std::make_pair( name( entry["owner"].as_string() ), balance.get_amount() );
+      };
+
+      if( state.contains( "hibernated" ) ) {
+         for( const auto& entry : state["hibernated"].get_array() ) {
+            const auto [owner, amount] = read_balance( entry );
+            hibernated[owner] += amount;
+            cold.set( owner.to_uint64_t(), hibernated[owner] );
+         }
+      }
+
+      fc::variants actions;
+      if( state.contains( "hibernate" ) ) {
+         for( const auto& entry : state["hibernate"].get_array() ) {
+            const auto [owner, amount] = read_balance( entry );
+            const auto proof = cold.prove( owner.to_uint64_t() );
+            actions.push_back( action_variant( "hibernate", mvo()
+               ( "owner", owner )
+               ( "hibernated", asset( proof.amount, sym ) )
+               ( "proof", proof_variant( sparse_merkle::compress( proof ) ) ) ) );
+
+            hibernated[owner] += amount;
+            cold.set( owner.to_uint64_t(), hibernated[owner] );
+         }
+      }
+
+      if( state.contains( "restore" ) ) {
+         for( const auto& entry : state["restore"].get_array() ) {
+            const name owner( entry.as_string() );
+            const auto proof = cold.prove( owner.to_uint64_t() );
+            if( proof.amount == 0 ) {
+               std::cerr << owner << " has no hibernated balance, skipped\n";
+               continue;
+            }
+            actions.push_back( action_variant( "restore", mvo()
+               ( "owner", owner )
+               ( "hibernated", asset( proof.amount, sym ) )
+               ( "ram_payer", ram_payer.empty() ? owner : name( ram_payer ) )
+               ( "proof", proof_variant( sparse_merkle::compress( proof ) ) ) ) );
+
+            hibernated.erase( owner );
+            cold.set( owner.to_uint64_t(), 0 );
+         }
+      }
+
+      int64_t supply = 0;
+      fc::variants remaining;
+      for( const auto& [owner, amount] : hibernated ) {
+         supply += amount;
+         remaining.push_back( mvo()( "owner", owner )( "balance", asset( amount, sym ) ) );
+      }
+
+      std::cout << fc::json::to_pretty_string( mvo()
+         ( "symbol", state["symbol"] )
+         ( "hibernated_root", cold.root() )
+         ( "hibernated_supply", asset( supply, sym ) )
+         ( "hibernated", remaining )
+         ( "actions", actions ) ) << std::endl;
+   } catch( const fc::exception& e ) {
+      std::cerr << e.to_detail_string() << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,401 @@
+/**
+ * Synthetic load on eosio.token, with the senders and receivers of the traffic drawn from a Zipf distribution so
+ * that a few accounts, e.g. exchanges, take most of it.
+ *
+ *    load_gen -- [--accounts 100000] [--actions 200000] [--zipf 1.0] [--mix 90:5:5] [--fee-share 20] [--fee 10]
+ *                [--exempt 10] [--per-trx 1] [--per-block 100] [--state-mb 4096] [--seed 1] [--report <path>]
+ *
+ * The generator creates `accounts` holders on a tester chain, funds every one of them with the `LOAD` token and,
+ * unless `fee-share` is 0, with the `FEE` token which charges `fee` hundredths of a percent per transfer. The
+ * `exempt` busiest senders are exempted from the fee. It then pushes `actions` actions, `per-trx` to a transaction
+ * and `per-block` transactions to a block, drawn from the `transfer:open:close` weights of `mix`:
+ *
+ * - `transfer` moves a small amount between two Zipf-drawn holders, of the `FEE` token for `fee-share` percent of
+ *   them and of the `LOAD` token otherwise,
+ * - `open` opens a Zipf-drawn holder's row of the `IDLE` token, paid by the holder,
+ * - `close` closes one of the opened `IDLE` rows.
+ *
+ * While the load runs, progress is printed every 10 blocks, and the report written to `report` at the end holds the
+ * actions per second, the billed CPU and elapsed time percentiles of each kind of action and the growth of the chain
+ * state database. The options follow `--` since the tester runs as a Boost.Test case, e.g. `load_gen -- --zipf 1.2`.
+ */
+#include "bench_report.hpp"
+#include "contracts.hpp"
+
+#include <eosio/testing/tester.hpp>
+
+#include <boost/test/included/unit_test.hpp>
+#include <fc/log/logger.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   struct options {
+      uint32_t accounts  = 100000;
+      uint64_t actions   = 200000;
+      double   zipf      = 1.0;
+      uint32_t transfers = 90, opens = 5, closes = 5;
+      uint32_t fee_share = 20;
+      uint8_t  fee       = 10;
+      uint32_t exempt    = 10;
+      uint32_t per_trx   = 1;
+      uint32_t per_block = 100;
+      uint64_t state_mb  = 4096;
+      uint64_t seed      = 1;
+      std::string report;
+
+      static options parse( int argc, char** argv ) {
+         options opts;
+         for( int i = 1; i < argc; ++i ) {
+            const std::string arg = argv[i];
+            EOS_ASSERT( i + 1 < argc, fc::invalid_arg_exception, "missing value of ${arg}", ("arg", arg) );
+            const std::string value = argv[++i];
+            if( arg == "--accounts" )       opts.accounts  = std::stoul( value );
+            else if( arg == "--actions" )   opts.actions   = std::stoull( value );
+            else if( arg == "--zipf" )      opts.zipf      = std::stod( value );
+            else if( arg == "--fee-share" ) opts.fee_share = std::stoul( value );
+            else if( arg == "--fee" )       opts.fee       = std::stoul( value );
+            else if( arg == "--exempt" )    opts.exempt    = std::stoul( value );
+            else if( arg == "--per-trx" )   opts.per_trx   = std::stoul( value );
+            else if( arg == "--per-block" ) opts.per_block = std::stoul( value );
+            else if( arg == "--state-mb" )  opts.state_mb  = std::stoull( value );
+            else if( arg == "--seed" )      opts.seed      = std::stoull( value );
+            else if( arg == "--report" )    opts.report    = value;
+            else if( arg == "--mix" ) {
+               EOS_ASSERT( std::sscanf( value.c_str(), "%u:%u:%u", &opts.transfers, &opts.opens, &opts.closes ) == 3,
+                           fc::invalid_arg_exception, "--mix takes transfer:open:close weights, got ${v}", ("v", value) );
+            }
+            else EOS_THROW( fc::invalid_arg_exception, "unknown option ${arg}", ("arg", arg) );
+         }
+         EOS_ASSERT( opts.accounts >= 2, fc::invalid_arg_exception, "at least 2 accounts are needed" );
+         EOS_ASSERT( opts.transfers + opts.opens + opts.closes > 0, fc::invalid_arg_exception, "empty --mix" );
+         EOS_ASSERT( opts.per_trx > 0 && opts.per_block > 0, fc::invalid_arg_exception, "empty transactions or blocks" );
+         return opts;
+      }
+
+      fc::variant to_variant()const {
+         return mvo()
+            ( "accounts", accounts )( "actions", actions )( "zipf", zipf )
+            ( "mix", mvo()( "transfer", transfers )( "open", opens )( "close", closes ) )
+            ( "fee_share", fee_share )( "fee", fee )( "exempt", exempt )
+            ( "per_trx", per_trx )( "per_block", per_block )( "seed", seed );
+      }
+   };
+
+   /// Draws ranks in [0, n), rank k with a probability proportional to 1 / (k + 1)^s.
+   class zipf_distribution {
+      public:
+         zipf_distribution( uint32_t n, double s ) : _cdf( n ) {
+            double sum = 0;
+            for( uint32_t k = 0; k < n; ++k ) {
+               _cdf[k] = sum += 1 / std::pow( k + 1, s );
+            }
+            for( auto& c : _cdf ) c /= sum;
+         }
+
+         template<typename Rng>
+         uint32_t operator()( Rng& rng )const {
+            const auto it = std::lower_bound( _cdf.begin(), _cdf.end(), std::uniform_real_distribution<double>()( rng ) );
+            return std::min<size_t>( it - _cdf.begin(), _cdf.size() - 1 );
+         }
+
+      private:
+         std::vector<double> _cdf;
+   };
+
+   /// The holder of rank `i`, named `load` followed by `i` in base 31.
+   name holder( uint32_t i ) {
+      static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz12345";
+      std::string s = "load";
+      for( int digit = 0; digit < 6; ++digit, i /= 31 ) {
+         s += alphabet[i % 31];
+      }
+      return name( s );
+   }
+
+   const name   token_account = "eosio.token"_n;
+   const name   issuer        = "loadissuer"_n;
+   const symbol load_symbol( 4, "LOAD" );
+   const symbol fee_symbol( 4, "FEE" );
+   const symbol idle_symbol( 4, "IDLE" );
+
+   class load_generator {
+      public:
+         load_generator( tester& chain, const options& opts )
+         :_chain( chain ), _opts( opts ), _zipf( opts.accounts, opts.zipf ), _rng( opts.seed ),
+          _idle_position( opts.accounts, -1 ) {}
+
+         void setup() {
+            _chain.create_accounts( { token_account, issuer } );
+            _chain.set_code( token_account, contracts::token_wasm() );
+            _chain.set_abi( token_account, contracts::token_abi().data() );
+            _chain.produce_block();
+
+            for( uint32_t i = 0; i < _opts.accounts; i += _opts.per_block ) {
+               vector<account_name> names;
+               for( uint32_t j = i; j < std::min( i + _opts.per_block, _opts.accounts ); ++j ) {
+                  names.push_back( holder( j ) );
+               }
+               _chain.create_accounts( names, false, false );
+               _chain.produce_block();
+               if( i / _opts.per_block % 100 == 99 ) {
+                  std::cerr << "created " << i + _opts.per_block << " accounts" << std::endl;
+               }
+            }
+
+            const int64_t funding = 1000'0000;
+            const auto supply = int64_t( _opts.accounts ) * funding * 2;
+            vector<symbol> funded{ load_symbol };
+            if( _opts.fee_share > 0 ) funded.push_back( fee_symbol );
+            for( const auto& sym : { load_symbol, fee_symbol, idle_symbol } ) {
+               _chain.push_action( token_account, "create"_n, token_account, mvo()
+                  ( "issuer", issuer )( "maximum_supply", asset( supply, sym ) ) );
+            }
+            for( const auto& sym : funded ) {
+               _chain.push_action( token_account, "issue"_n, issuer, mvo()
+                  ( "to", issuer )( "quantity", asset( supply, sym ) )( "memo", "" ) );
+            }
+            _chain.push_action( token_account, "setfee"_n, issuer, mvo()
+               ( "issuer", issuer )( "symbol", fee_symbol )( "fees", _opts.fee ) );
+            for( uint32_t rank = 0; rank < std::min( _opts.exempt, _opts.accounts ); ++rank ) {
+               _chain.push_action( token_account, "switchexempt"_n, issuer, mvo()
+                  ( "issuer", issuer )( "symbol", fee_symbol )( "account", holder( rank ) ) );
+            }
+            _chain.produce_block();
+
+            // every holder starts with the same balances, funded 100 rows to a transaction
+            for( const auto& sym : funded ) {
+               for( uint32_t i = 0; i < _opts.accounts; i += 100 ) {
+                  signed_transaction trx;
+                  for( uint32_t j = i; j < std::min( i + 100, _opts.accounts ); ++j ) {
+                     trx.actions.push_back( transfer( issuer, holder( j ), asset( funding, sym ) ) );
+                  }
+                  push( trx, { issuer } );
+                  if( i / 100 % _opts.per_block == _opts.per_block - 1 ) _chain.produce_block();
+               }
+               _chain.produce_block();
+            }
+         }
+
+         fc::variant run() {
+            const uint32_t total_weight = _opts.transfers + _opts.opens + _opts.closes;
+            std::uniform_int_distribution<uint32_t> pick_kind( 0, total_weight - 1 );
+            std::uniform_int_distribution<uint32_t> pick_percent( 0, 99 );
+            std::uniform_int_distribution<int64_t>  pick_amount( 1, 1'0000 );
+
+            fc::variants growth;
+            const auto sample_growth = [&]( uint64_t done ) {
+               growth.push_back( mvo()
+                  ( "actions", done )
+                  ( "state_db_bytes", state_db_used() )
+                  ( "contract_ram_bytes", _chain.control->get_resource_limits_manager().get_account_ram_usage( token_account ) ) );
+            };
+            sample_growth( 0 );
+
+            const auto start = std::chrono::steady_clock::now();
+            uint64_t done = 0, failed = 0, transfers = 0;
+            uint32_t blocks = 0, pending = 0;
+            while( done < _opts.actions ) {
+               signed_transaction trx;
+               vector<account_name> signers;
+               std::string kind;
+               const auto kind_of_trx = [&]( const char* action_kind ) {
+                  kind = kind.empty() || kind == action_kind ? action_kind : "mixed";
+               };
+               std::vector<std::pair<uint32_t, bool>> idle_changes;
+
+               for( uint32_t i = 0; i < _opts.per_trx && done + i < _opts.actions; ++i ) {
+                  const auto k = pick_kind( _rng );
+                  if( k < _opts.transfers ) {
+                     const auto from = _zipf( _rng );
+                     auto to = _zipf( _rng );
+                     while( to == from ) to = _zipf( _rng );
+                     const auto& sym = pick_percent( _rng ) < _opts.fee_share ? fee_symbol : load_symbol;
+                     trx.actions.push_back( transfer( holder( from ), holder( to ), asset( pick_amount( _rng ), sym ) ) );
+                     signers.push_back( holder( from ) );
+                     kind_of_trx( "transfer" );
+                  } else if( k < _opts.transfers + _opts.opens || _idle.empty() ) {
+                     // falls back to the already opened row when the draws keep hitting them
+                     auto owner = _zipf( _rng );
+                     for( int retry = 0; retry < 8 && _idle_position[owner] >= 0; ++retry ) owner = _zipf( _rng );
+                     trx.actions.push_back( open( holder( owner ) ) );
+                     signers.push_back( holder( owner ) );
+                     if( _idle_position[owner] < 0 ) {
+                        add_idle( owner );
+                        idle_changes.emplace_back( owner, true );
+                     }
+                     kind_of_trx( "open" );
+                  } else {
+                     const auto owner = _idle[ std::uniform_int_distribution<size_t>( 0, _idle.size() - 1 )( _rng ) ];
+                     trx.actions.push_back( close( holder( owner ) ) );
+                     signers.push_back( holder( owner ) );
+                     remove_idle( owner );
+                     idle_changes.emplace_back( owner, false );
+                     kind_of_trx( "close" );
+                  }
+               }
+
+               std::sort( signers.begin(), signers.end() );
+               signers.erase( std::unique( signers.begin(), signers.end() ), signers.end() );
+
+               const auto trace = push( trx, signers );
+               if( trace ) {
+                  _billed[kind].add( trace->receipt->cpu_usage_us );
+                  _elapsed[kind].add( trace->elapsed.count() );
+                  for( const auto& act : trx.actions ) {
+                     if( act.name == "transfer"_n ) ++transfers;
+                  }
+               } else {
+                  ++failed;
+                  for( auto it = idle_changes.rbegin(); it != idle_changes.rend(); ++it ) {
+                     if( it->second ) remove_idle( it->first );
+                     else add_idle( it->first );
+                  }
+               }
+               done += trx.actions.size();
+
+               if( ++pending == _opts.per_block ) {
+                  _chain.produce_block();
+                  pending = 0;
+                  if( ++blocks % 10 == 0 ) {
+                     const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+                     sample_growth( done );
+                     std::cerr << done << " actions, " << uint64_t( done / seconds.count() ) << " actions/s, "
+                               << failed << " failed transactions, state " << state_db_used() / ( 1024 * 1024 )
+                               << " MiB" << std::endl;
+                  }
+               }
+            }
+            _chain.produce_block();
+            const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+            sample_growth( done );
+
+            fc::mutable_variant_object actions;
+            for( const auto& [label, usage] : _billed ) {
+               actions( label, mvo()
+                  ( "billed_us", usage.to_variant() )
+                  ( "elapsed_us", _elapsed.at( label ).to_variant() ) );
+            }
+            return mvo()
+               ( "options", _opts.to_variant() )
+               ( "seconds", seconds.count() )
+               ( "actions", done )
+               ( "failed_transactions", failed )
+               ( "actions_per_sec", done / seconds.count() )
+               ( "transfers_per_sec", transfers / seconds.count() )
+               ( "transactions", actions )
+               ( "state_growth", growth );
+         }
+
+      private:
+         action transfer( name from, name to, const asset& quantity )const {
+            return action( { { from, config::active_name } }, token_account, "transfer"_n,
+                           fc::raw::pack( from, to, quantity, std::string() ) );
+         }
+
+         action open( name owner )const {
+            return action( { { owner, config::active_name } }, token_account, "open"_n,
+                           fc::raw::pack( owner, idle_symbol, owner ) );
+         }
+
+         action close( name owner )const {
+            return action( { { owner, config::active_name } }, token_account, "close"_n,
+                           fc::raw::pack( owner, idle_symbol ) );
+         }
+
+         // the trace of `trx`, or null if it failed; a full block is produced and the transaction pushed again
+         transaction_trace_ptr push( signed_transaction& trx, const vector<account_name>& signers ) {
+            for( int attempt = 0; attempt < 2; ++attempt ) {
+               // the expiration varies so that repeated actions are distinct transactions
+               _chain.set_transaction_headers( trx, 60 + _sequence++ % 3000 );
+               trx.signatures.clear();
+               for( const auto& signer : signers ) {
+                  trx.sign( key( signer ), _chain.control->get_chain_id() );
+               }
+               try {
+                  return _chain.push_transaction( trx, fc::time_point::maximum(), 0 );
+               } catch( const block_cpu_usage_exceeded& ) {
+                  _chain.produce_block();
+               } catch( const block_net_usage_exceeded& ) {
+                  _chain.produce_block();
+               } catch( const fc::exception& ) {
+                  return nullptr;
+               }
+            }
+            return nullptr;
+         }
+
+         uint64_t state_db_used()const {
+            return _opts.state_mb * 1024 * 1024 - _chain.control->db().get_free_memory();
+         }
+
+         const fc::crypto::private_key& key( name account ) {
+            auto it = _keys.find( account );
+            if( it == _keys.end() ) {
+               it = _keys.emplace( account, tester::get_private_key( account, "active" ) ).first;
+            }
+            return it->second;
+         }
+
+         void add_idle( uint32_t owner ) {
+            _idle_position[owner] = _idle.size();
+            _idle.push_back( owner );
+         }
+
+         void remove_idle( uint32_t owner ) {
+            const auto position = _idle_position[owner];
+            _idle[position] = _idle.back();
+            _idle_position[_idle[position]] = position;
+            _idle.pop_back();
+            _idle_position[owner] = -1;
+         }
+
+         tester&                 _chain;
+         const options&          _opts;
+         zipf_distribution       _zipf;
+         std::mt19937_64         _rng;
+         uint32_t                _sequence = 0;
+         // the holders with an `IDLE` row, and the position of each holder in `_idle` or -1
+         std::vector<uint32_t>   _idle;
+         std::vector<int64_t>    _idle_position;
+         std::map<name, fc::crypto::private_key>     _keys;
+         std::map<std::string, bench::distribution>  _billed, _elapsed;
+   };
+
+   void run_load() {
+      const auto& suite = boost::unit_test::framework::master_test_suite();
+      const auto opts = options::parse( suite.argc, suite.argv );
+
+      fc::temp_directory tempdir;
+      auto [cfg, genesis] = tester::default_config( tempdir );
+      cfg.state_size = opts.state_mb * 1024 * 1024;
+      tester chain( cfg, genesis );
+      chain.execute_setup_policy( setup_policy::full );
+
+      load_generator generator( chain, opts );
+      const auto setup_start = std::chrono::steady_clock::now();
+      generator.setup();
+      const std::chrono::duration<double> setup_seconds = std::chrono::steady_clock::now() - setup_start;
+      std::cerr << "set up " << opts.accounts << " holders in " << setup_seconds.count() << " s" << std::endl;
+
+      auto report = mvo( generator.run().get_object() )( "setup_seconds", setup_seconds.count() );
+      bench::save( report, opts.report );
+      std::cout << fc::json::to_pretty_string( report ) << std::endl;
+   }
+
+}
+
+boost::unit_test::test_suite* init_unit_test_suite( int argc, char* argv[] ) {
+   fc::logger::get( DEFAULT_LOGGER ).set_log_level( fc::log_level::off );
+   boost::unit_test::framework::master_test_suite().add( BOOST_TEST_CASE( &run_load ) );
+   return nullptr;
+}
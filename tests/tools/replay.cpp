@@ -0,0 +1,543 @@
+/**
+ * Replays a recording of token actions against the contract under test, e.g. to compare two builds of the contract
+ * on the same production traffic before a `setcode`.
+ *
+ *    replay -- <recording> [--binary] [--contract eosio.token] [--wasm <path> --abi <path>] [--per-block 100]
+ *              [--state-mb 4096] [--report <path>]
+ *
+ * The recording is either JSON lines, one action per line as returned by the history APIs, with its `data` as an
+ * object or as hex, and the action traces of the history APIs are read from their `act`. A trace whose `receiver`
+ * is not the account of its action is the copy seen by a notified account, and is dropped:
+ *
+ *    { "account": "eosio.token", "name": "transfer", "authorization": [ { "actor": "bob", "permission": "active" } ],
+ *      "data": { "from": "bob", "to": "alice", "quantity": "1.0000 TKN", "memo": "" } }
+ *
+ * or, with `--binary` or a `.bin` extension, the actions packed one after the other as `eosio::chain::action`.
+ * Actions of other contracts than `contract` are skipped. The contract is the one built with the tests, unless the
+ * `wasm` and `abi` of another build are given.
+ *
+ * Before the replay, every account named by an action, as an authorizer or in a `name` field, is created with the
+ * tester keys, and every token used but not created by the recording is created with the issuer of its first
+ * `issue`. A token only named by a symbol code, as by `xfer`, is created with a precision of 0. Going through the
+ * transfers, swaps, issues, retirements, sub-account moves and restores of the recording, with the fees and
+ * exemptions it sets, gives the lowest balance each holder and sub-account reaches, and they are funded so that it
+ * is zero.
+ *
+ * The actions are then pushed in order, each in its own transaction. `hibernate` and `restore` are not replayed,
+ * since their proofs are against a cold tree the replay does not have, and are reported as unsupported. The report
+ * written to `report` holds the billed CPU and elapsed time distributions of each action and the failed actions
+ * with their error.
+ */
+#include "bench_report.hpp"
+#include "contracts.hpp"
+
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <boost/test/included/unit_test.hpp>
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <set>
+#include <tuple>
+
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   struct options {
+      std::string recording;
+      bool        binary    = false;
+      name        contract  = "eosio.token"_n;
+      std::string wasm;
+      std::string abi;
+      uint32_t    per_block = 100;
+      uint64_t    state_mb  = 4096;
+      std::string report;
+
+      static options parse( int argc, char** argv ) {
+         options opts;
+         for( int i = 1; i < argc; ++i ) {
+            const std::string arg = argv[i];
+            if( arg == "--binary" ) {
+               opts.binary = true;
+               continue;
+            }
+            if( arg.rfind( "--", 0 ) != 0 ) {
+               opts.recording = arg;
+               continue;
+            }
+            EOS_ASSERT( i + 1 < argc, fc::invalid_arg_exception, "missing value of ${arg}", ("arg", arg) );
+            const std::string value = argv[++i];
+            if( arg == "--contract" )       opts.contract  = name( value );
+            else if( arg == "--wasm" )      opts.wasm      = value;
+            else if( arg == "--abi" )       opts.abi       = value;
+            else if( arg == "--per-block" ) opts.per_block = std::stoul( value );
+            else if( arg == "--state-mb" )  opts.state_mb  = std::stoull( value );
+            else if( arg == "--report" )    opts.report    = value;
+            else EOS_THROW( fc::invalid_arg_exception, "unknown option ${arg}", ("arg", arg) );
+         }
+         EOS_ASSERT( !opts.recording.empty(), fc::invalid_arg_exception, "no recording given" );
+         EOS_ASSERT( opts.wasm.empty() == opts.abi.empty(), fc::invalid_arg_exception, "--wasm and --abi go together" );
+         EOS_ASSERT( opts.per_block > 0, fc::invalid_arg_exception, "empty blocks" );
+         if( opts.recording.size() > 4 && opts.recording.compare( opts.recording.size() - 4, 4, ".bin" ) == 0 ) {
+            opts.binary = true;
+         }
+         return opts;
+      }
+   };
+
+   template<typename T>
+   std::vector<T> read_file( const std::string& path ) {
+      std::ifstream in( path, std::ios::binary );
+      EOS_ASSERT( in, fc::invalid_arg_exception, "cannot read ${path}", ("path", path) );
+      return std::vector<T>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+   }
+
+   const auto yield = abi_serializer::create_yield_function( fc::seconds( 1 ) );
+
+   std::vector<action> read_recording( const options& opts, const abi_serializer& abi ) {
+      std::vector<action> actions;
+      if( opts.binary ) {
+         const auto bytes = read_file<char>( opts.recording );
+         fc::datastream<const char*> ds( bytes.data(), bytes.size() );
+         while( ds.remaining() ) {
+            action act;
+            fc::raw::unpack( ds, act );
+            actions.push_back( std::move( act ) );
+         }
+         return actions;
+      }
+
+      std::ifstream in( opts.recording );
+      EOS_ASSERT( in, fc::invalid_arg_exception, "cannot read ${path}", ("path", opts.recording) );
+      std::string line;
+      uint64_t notified = 0;
+      for( uint32_t number = 1; std::getline( in, line ); ++number ) {
+         if( line.find_first_not_of( " \t\r" ) == std::string::npos ) continue;
+         try {
+            auto entry = fc::json::from_string( line ).get_object();
+            if( entry.contains( "action_trace" ) ) entry = entry["action_trace"].get_object();
+            std::optional<name> receiver;
+            if( entry.contains( "receiver" ) ) {
+               receiver = name( entry["receiver"].as_string() );
+            } else if( entry.contains( "receipt" ) && entry["receipt"].is_object() ) {
+               receiver = name( entry["receipt"]["receiver"].as_string() );
+            }
+            if( entry.contains( "act" ) ) entry = entry["act"].get_object();
+
+            action act;
+            act.account       = entry.contains( "account" ) ? name( entry["account"].as_string() ) : opts.contract;
+            act.name          = name( entry["name"].as_string() );
+            act.authorization = entry["authorization"].as<vector<permission_level>>();
+            if( receiver && *receiver != act.account ) {
+               ++notified;
+               continue;
+            }
+            if( entry.contains( "hex_data" ) ) {
+               act.data = entry["hex_data"].as<bytes>();
+            } else if( entry["data"].is_string() ) {
+               act.data = entry["data"].as<bytes>();
+            } else if( act.account == opts.contract ) {
+               act.data = abi.variant_to_binary( abi.get_action_type( act.name ), entry["data"], yield );
+            }
+            // the data of another contract's action is left out, it is skipped without being decoded
+            actions.push_back( std::move( act ) );
+         } FC_CAPTURE_AND_RETHROW( (number) )
+      }
+      if( notified ) std::cerr << "dropped " << notified << " notified copies of actions" << std::endl;
+      return actions;
+   }
+
+   /// Balances of the holders and their sub-accounts through the recording, to fund each one with what it sends
+   /// before receiving it. Tokens are told apart by symbol code, which is all `xfer` names.
+   class holdings {
+      public:
+         /// Balance of a holder, or of one of its sub-accounts, in a token.
+         struct holder {
+            name                     owner;
+            std::optional<uint64_t>  subaccount;
+            uint64_t                 code;
+
+            friend bool operator<( const holder& a, const holder& b ) {
+               return std::tie( a.owner, a.subaccount, a.code ) < std::tie( b.owner, b.subaccount, b.code );
+            }
+         };
+
+         void issue( name to, const asset& quantity ) {
+            add( { to, {}, code_of( quantity ) }, quantity.get_amount() );
+         }
+
+         void retire( name issuer, const asset& quantity ) {
+            add( { issuer, {}, code_of( quantity ) }, -quantity.get_amount() );
+         }
+
+         // charged as `token::settle` does
+         void transfer( name from, name to, const asset& quantity, name issuer ) {
+            const auto code = code_of( quantity );
+            const int64_t fee = quantity.get_amount() / 10000 * fees[code];
+            const bool exempted = exempt.count( { code, from } );
+            add( { from, {}, code }, -quantity.get_amount() - ( exempted ? 0 : fee ) );
+            add( { to, {}, code }, quantity.get_amount() - ( exempted ? fee : 0 ) );
+            add( { issuer, {}, code }, fee );
+         }
+
+         void subdeposit( name owner, uint64_t subaccount, const asset& quantity ) {
+            add( { owner, {}, code_of( quantity ) }, -quantity.get_amount() );
+            add( { owner, subaccount, code_of( quantity ) }, quantity.get_amount() );
+         }
+
+         void subwithdraw( name owner, uint64_t subaccount, const asset& quantity ) {
+            add( { owner, subaccount, code_of( quantity ) }, -quantity.get_amount() );
+            add( { owner, {}, code_of( quantity ) }, quantity.get_amount() );
+         }
+
+         void submove( name owner, uint64_t from, uint64_t to, const asset& quantity ) {
+            add( { owner, from, code_of( quantity ) }, -quantity.get_amount() );
+            add( { owner, to, code_of( quantity ) }, quantity.get_amount() );
+         }
+
+         // the restore is not replayed, the restored balance is funded instead
+         void restore( name owner, const asset& hibernated ) {
+            add( { owner, {}, code_of( hibernated ) }, hibernated.get_amount() );
+         }
+
+         void setfee( const symbol& sym, uint8_t fee ) {
+            fees[sym.to_symbol_code().value] = fee;
+         }
+
+         void switchexempt( const symbol& sym, name account ) {
+            const auto code = sym.to_symbol_code().value;
+            if( !exempt.erase( { code, account } ) ) exempt.insert( { code, account } );
+         }
+
+         /// What each holder and sub-account must be funded with.
+         std::map<holder, int64_t> deficits()const {
+            std::map<holder, int64_t> result;
+            for( const auto& [key, amount] : lowest ) {
+               if( amount < 0 ) result[key] = -amount;
+            }
+            return result;
+         }
+
+      private:
+         static uint64_t code_of( const asset& quantity ) {
+            return quantity.get_symbol().to_symbol_code().value;
+         }
+
+         void add( const holder& key, int64_t amount ) {
+            auto& balance = balances[key];
+            balance += amount;
+            auto& low = lowest[key];
+            low = std::min( low, balance );
+         }
+
+         std::map<holder, int64_t>            balances, lowest;
+         std::map<uint64_t, uint8_t>          fees;
+         std::set<std::pair<uint64_t, name>>  exempt;
+   };
+
+   /// Actions whose effect the replay cannot reproduce, they are reported instead of pushed.
+   bool is_unsupported( name action_name ) {
+      return action_name == "hibernate"_n || action_name == "restore"_n;
+   }
+
+   class replayer {
+      public:
+         replayer( tester& chain, const options& opts )
+         :_chain( chain ), _opts( opts ) {
+            _wasm = opts.wasm.empty() ? contracts::token_wasm() : read_file<uint8_t>( opts.wasm );
+            _abi_json = opts.abi.empty() ? contracts::token_abi() : read_file<char>( opts.abi );
+            _abi_json.push_back( '\0' );
+            _abi.set_abi( fc::json::from_string( _abi_json.data() ).as<abi_def>(), yield );
+         }
+
+         const abi_serializer& abi()const { return _abi; }
+
+         fc::variant bootstrap( std::vector<action>& actions ) {
+            std::set<name> accounts{ _opts.contract };
+            // tokens and issuers by symbol code
+            std::map<uint64_t, name> issuers;
+            std::map<uint64_t, symbol> tokens;
+            std::set<uint64_t> created;
+            holdings simulated;
+
+            for( auto& act : actions ) {
+               if( act.account != _opts.contract ) continue;
+               for( auto& auth : act.authorization ) {
+                  accounts.insert( auth.actor );
+                  // the tester accounts only have the `owner` and `active` permissions
+                  if( auth.permission != config::owner_name ) auth.permission = config::active_name;
+               }
+
+               const auto type = _abi.get_action_type( act.name );
+               if( type.empty() ) continue;
+               const auto data = _abi.binary_to_variant( type, act.data, yield );
+               for( const auto& field : _abi.get_struct( type ).fields ) {
+                  const auto& value = data[field.name];
+                  if( field.type == "name" ) {
+                     accounts.insert( name( value.as_string() ) );
+                  } else if( field.type == "name[]" ) {
+                     for( const auto& n : value.get_array() ) accounts.insert( name( n.as_string() ) );
+                  } else if( field.type == "asset" ) {
+                     const auto sym = asset::from_string( value.as_string() ).get_symbol();
+                     tokens[sym.to_symbol_code().value] = sym;
+                  } else if( field.type == "symbol" ) {
+                     const auto sym = symbol::from_string( value.as_string() );
+                     tokens[sym.to_symbol_code().value] = sym;
+                  } else if( field.type == "symbol_code" ) {
+                     // a precision named anywhere else in the recording takes over
+                     const auto sym = symbol::from_string( "0," + value.as_string() );
+                     tokens.emplace( sym.to_symbol_code().value, sym );
+                  }
+               }
+
+               const auto issuer_of = [&]( const asset& quantity ) {
+                  const auto code = quantity.get_symbol().to_symbol_code().value;
+                  return issuers.count( code ) ? issuers[code] : act.authorization.front().actor;
+               };
+               if( act.name == "create"_n ) {
+                  const auto max_supply = asset::from_string( data["maximum_supply"].as_string() );
+                  created.insert( max_supply.get_symbol().to_symbol_code().value );
+                  issuers.emplace( max_supply.get_symbol().to_symbol_code().value, name( data["issuer"].as_string() ) );
+               } else if( act.name == "issue"_n ) {
+                  const auto quantity = asset::from_string( data["quantity"].as_string() );
+                  issuers.emplace( quantity.get_symbol().to_symbol_code().value, act.authorization.front().actor );
+                  simulated.issue( name( data["to"].as_string() ), quantity );
+               } else if( act.name == "retire"_n ) {
+                  const auto quantity = asset::from_string( data["quantity"].as_string() );
+                  simulated.retire( issuer_of( quantity ), quantity );
+               } else if( act.name == "transfer"_n || act.name == "transferid"_n ) {
+                  const auto quantity = asset::from_string( data["quantity"].as_string() );
+                  simulated.transfer( name( data["from"].as_string() ), name( data["to"].as_string() ), quantity,
+                                      issuer_of( quantity ) );
+               } else if( act.name == "xfer"_n ) {
+                  // the fee only depends on the amount, so any precision does
+                  const asset quantity( data["amount"].as<int64_t>(), symbol::from_string( "0," + data["sym"].as_string() ) );
+                  simulated.transfer( name( data["from"].as_string() ), name( data["to"].as_string() ), quantity,
+                                      issuer_of( quantity ) );
+               } else if( act.name == "swap"_n ) {
+                  const name a( data["a"].as_string() ), b( data["b"].as_string() );
+                  const auto quantity_a = asset::from_string( data["quantity_a"].as_string() );
+                  const auto quantity_b = asset::from_string( data["quantity_b"].as_string() );
+                  simulated.transfer( a, b, quantity_a, issuer_of( quantity_a ) );
+                  simulated.transfer( b, a, quantity_b, issuer_of( quantity_b ) );
+               } else if( act.name == "subdeposit"_n || act.name == "subwithdraw"_n ) {
+                  const name owner( data["owner"].as_string() );
+                  const auto subaccount = data["subaccount"].as<uint64_t>();
+                  const auto quantity = asset::from_string( data["quantity"].as_string() );
+                  if( act.name == "subdeposit"_n ) simulated.subdeposit( owner, subaccount, quantity );
+                  else                             simulated.subwithdraw( owner, subaccount, quantity );
+               } else if( act.name == "submove"_n ) {
+                  simulated.submove( name( data["owner"].as_string() ), data["from"].as<uint64_t>(), data["to"].as<uint64_t>(),
+                                     asset::from_string( data["quantity"].as_string() ) );
+               } else if( act.name == "restore"_n ) {
+                  simulated.restore( name( data["owner"].as_string() ), asset::from_string( data["hibernated"].as_string() ) );
+               } else if( act.name == "setfee"_n ) {
+                  simulated.setfee( symbol::from_string( data["symbol"].as_string() ), data["fees"].as<uint8_t>() );
+               } else if( act.name == "switchexempt"_n ) {
+                  simulated.switchexempt( symbol::from_string( data["symbol"].as_string() ), name( data["account"].as_string() ) );
+               }
+            }
+
+            const name bootstrap_issuer = "replayissuer"_n;
+            accounts.insert( bootstrap_issuer );
+            uint32_t new_accounts = 0;
+            vector<account_name> batch;
+            for( const auto& account : accounts ) {
+               if( _chain.control->db().find<account_object, by_name>( account ) ) continue;
+               batch.push_back( account );
+               ++new_accounts;
+               if( batch.size() == _opts.per_block ) {
+                  _chain.create_accounts( batch, false, false );
+                  _chain.produce_block();
+                  batch.clear();
+               }
+            }
+            _chain.create_accounts( batch, false, false );
+
+            _chain.set_code( _opts.contract, _wasm );
+            _chain.set_abi( _opts.contract, _abi_json.data() );
+            _chain.produce_block();
+
+            // the tokens the recording creates are left to it, with their balances
+            std::map<uint64_t, int64_t> issued;
+            const auto deficits = simulated.deficits();
+            for( const auto& [key, amount] : deficits ) {
+               if( !created.count( key.code ) ) issued[key.code] += amount;
+            }
+
+            fc::variants bootstrapped;
+            for( const auto& [code, sym] : tokens ) {
+               if( created.count( code ) ) continue;
+               const auto issuer = issuers.count( code ) ? issuers[code] : bootstrap_issuer;
+               push_setup( "create"_n, _opts.contract, mvo()
+                  ( "issuer", issuer )( "maximum_supply", asset( asset::max_amount, sym ) ) );
+               if( issued[code] > 0 ) {
+                  push_setup( "issue"_n, issuer, mvo()
+                     ( "to", issuer )( "quantity", asset( issued[code], sym ) )( "memo", "replay funding" ) );
+               }
+               bootstrapped.push_back( mvo()( "symbol", sym )( "issuer", issuer )( "funded", asset( issued[code], sym ) ) );
+               issuers[code] = issuer;
+            }
+
+            // a sub-account is funded through its owner, who deposits what it is sent
+            uint32_t funded = 0;
+            for( const auto& [key, amount] : deficits ) {
+               if( created.count( key.code ) ) continue;
+               const asset quantity( amount, tokens.at( key.code ) );
+               if( key.owner != issuers[key.code] ) {
+                  push_setup( "transfer"_n, issuers[key.code], mvo()
+                     ( "from", issuers[key.code] )( "to", key.owner )( "quantity", quantity )( "memo", "replay funding" ) );
+               } else if( !key.subaccount ) {
+                  continue;
+               }
+               if( key.subaccount ) {
+                  push_setup( "subdeposit"_n, key.owner, mvo()
+                     ( "owner", key.owner )( "subaccount", *key.subaccount )( "quantity", quantity ) );
+               }
+               if( ++funded % _opts.per_block == 0 ) _chain.produce_block();
+            }
+            _chain.produce_block();
+
+            return mvo()
+               ( "accounts", new_accounts )
+               ( "tokens", bootstrapped )
+               ( "funded_holders", funded );
+         }
+
+         fc::variant replay( const std::vector<action>& actions ) {
+            std::map<name, bench::distribution> billed, elapsed;
+            std::map<name, uint64_t> failures_by_action, unsupported;
+            fc::variants failures;
+            uint64_t replayed = 0, skipped = 0, failed = 0;
+
+            for( size_t index = 0; index < actions.size(); ++index ) {
+               const auto& act = actions[index];
+               if( act.account != _opts.contract ) {
+                  ++skipped;
+                  continue;
+               }
+               if( is_unsupported( act.name ) ) {
+                  ++unsupported[act.name];
+                  continue;
+               }
+
+               signed_transaction trx;
+               trx.actions.push_back( act );
+               try {
+                  const auto trace = push( trx );
+                  billed[act.name].add( trace->receipt->cpu_usage_us );
+                  elapsed[act.name].add( trace->elapsed.count() );
+               } catch( const fc::exception& e ) {
+                  ++failed;
+                  ++failures_by_action[act.name];
+                  // the first failures are kept, later ones are only counted
+                  if( failures.size() < 1000 ) {
+                     failures.push_back( mvo()( "index", index )( "action", act.name )( "error", e.top_message() ) );
+                  }
+               }
+               if( ++replayed % _opts.per_block == 0 ) _chain.produce_block();
+               if( replayed % 100000 == 0 ) {
+                  std::cerr << replayed << " actions replayed, " << failed << " failed" << std::endl;
+               }
+            }
+            _chain.produce_block();
+
+            fc::mutable_variant_object by_action;
+            for( const auto& [action_name, usage] : billed ) {
+               by_action( action_name.to_string(), mvo()
+                  ( "failed", failures_by_action[action_name] )
+                  ( "billed_us", usage.to_variant() )
+                  ( "elapsed_us", elapsed.at( action_name ).to_variant() ) );
+            }
+            for( const auto& [action_name, count] : failures_by_action ) {
+               if( !billed.count( action_name ) ) by_action( action_name.to_string(), mvo()( "failed", count ) );
+            }
+            fc::mutable_variant_object unsupported_actions;
+            for( const auto& [action_name, count] : unsupported ) {
+               unsupported_actions( action_name.to_string(), count );
+            }
+            return mvo()
+               ( "replayed", replayed - failed )
+               ( "failed", failed )
+               ( "skipped", skipped )
+               ( "unsupported", unsupported_actions )
+               ( "actions", by_action )
+               ( "failures", failures );
+         }
+
+      private:
+         void push_setup( name action_name, name actor, const mvo& data ) {
+            _chain.push_action( _opts.contract, action_name, actor, data );
+         }
+
+         // a full block is produced and the transaction pushed again
+         transaction_trace_ptr push( signed_transaction& trx ) {
+            for( int attempt = 0; ; ++attempt ) {
+               // the expiration varies so that repeated actions are distinct transactions
+               _chain.set_transaction_headers( trx, 60 + _sequence++ % 3000 );
+               trx.signatures.clear();
+               std::set<permission_level> signers;
+               for( const auto& act : trx.actions ) {
+                  signers.insert( act.authorization.begin(), act.authorization.end() );
+               }
+               for( const auto& signer : signers ) {
+                  trx.sign( tester::get_private_key( signer.actor, signer.permission.to_string() ), _chain.control->get_chain_id() );
+               }
+               try {
+                  // billed from the measured CPU time, rather than the fixed time the tester bills by default
+                  return _chain.push_transaction( trx, fc::time_point::maximum(), 0 );
+               } catch( const block_cpu_usage_exceeded& ) {
+                  if( attempt > 0 ) throw;
+               } catch( const block_net_usage_exceeded& ) {
+                  if( attempt > 0 ) throw;
+               }
+               _chain.produce_block();
+            }
+         }
+
+         tester&              _chain;
+         const options&       _opts;
+         vector<uint8_t>      _wasm;
+         vector<char>         _abi_json;
+         abi_serializer       _abi;
+         uint32_t             _sequence = 0;
+   };
+
+   void run_replay() {
+      const auto& suite = boost::unit_test::framework::master_test_suite();
+      const auto opts = options::parse( suite.argc, suite.argv );
+
+      fc::temp_directory tempdir;
+      auto [cfg, genesis] = tester::default_config( tempdir );
+      cfg.state_size = opts.state_mb * 1024 * 1024;
+      tester chain( cfg, genesis );
+      chain.execute_setup_policy( setup_policy::full );
+
+      replayer replay( chain, opts );
+      auto actions = read_recording( opts, replay.abi() );
+      std::cerr << "read " << actions.size() << " actions from " << opts.recording << std::endl;
+
+      const auto bootstrap = replay.bootstrap( actions );
+      auto report = mvo( replay.replay( actions ).get_object() )
+         ( "recording", opts.recording )
+         ( "contract", opts.wasm.empty() ? std::string( "built with the tests" ) : opts.wasm )
+         ( "bootstrap", bootstrap );
+      bench::save( report, opts.report );
+      std::cout << fc::json::to_pretty_string( report ) << std::endl;
+   }
+
+}
+
+boost::unit_test::test_suite* init_unit_test_suite( int argc, char* argv[] ) {
+   fc::logger::get( DEFAULT_LOGGER ).set_log_level( fc::log_level::off );
+   boost::unit_test::framework::master_test_suite().add( BOOST_TEST_CASE( &run_replay ) );
+   return nullptr;
+}
@@ -0,0 +1,696 @@
+#pragma once
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * Deterministic instruction counts of contract actions, from an instrumented copy of the contract.
+ *
+ * `instrument` rewrites a wasm module so that each function adds the number of instructions of every straight-line
+ * run it enters to a counter of its own, a mutable global. The `apply` export is wrapped so that, once the action
+ * has run, the `magic` bytes and the counters are written to the start of the linear memory, which the action no
+ * longer uses, and printed with `printhex`. `counts` reads them back from the console of the action trace. The
+ * counts do not depend on the machine or on the wasm runtime, so two builds of the contract compare exactly.
+ *
+ * eosio allows 1024 bytes of mutable globals, so when the contract has more functions than counters fit in, the
+ * functions whose name contains `focus`, then the largest ones, get a counter and the others share `(other)`.
+ * Functions are named from the `name` section of a build which keeps it, and `f<index>` otherwise.
+ *
+ * The imported host functions listed in `hosts` are also accounted: their calls go through a stub which counts them,
+ * and for the database functions adds the bytes passed in or out of the row, before calling the host. Their
+ * counters follow those of the functions, see `host_usage`.
+ */
+namespace wasm_profile {
+
+   constexpr char     magic[] = "wasmprof";
+   constexpr uint32_t magic_size = 8;
+   constexpr uint32_t max_mutable_global_bytes = 1024;
+
+   struct instrumented {
+      std::vector<uint8_t>     wasm;
+      std::vector<std::string> counters; ///< name of the functions counted by each counter
+      std::vector<std::string> hosts;    ///< host functions accounted, each with a calls and a bytes counter
+
+      size_t printed()const { return counters.size() + 2 * hosts.size(); }
+   };
+
+   struct host_calls {
+      uint32_t calls = 0;
+      uint32_t bytes = 0;
+   };
+
+   /// the host functions whose calls move row bytes, and the parameter holding their length
+   inline const std::map<std::string, uint32_t>& row_length_params() {
+      static const std::map<std::string, uint32_t> params = {
+         { "db_get_i64", 2 },    // itr, data, len
+         { "db_store_i64", 5 },  // scope, table, payer, id, data, len
+         { "db_update_i64", 3 }, // itr, payer, data, len
+      };
+      return params;
+   }
+
+   namespace detail {
+
+      struct reader {
+         const uint8_t* pos;
+         const uint8_t* end;
+
+         bool done()const { return pos == end; }
+
+         uint8_t byte() {
+            FC_ASSERT( pos < end, "unexpected end of the wasm module" );
+            return *pos++;
+         }
+
+         uint64_t u() {
+            uint64_t result = 0;
+            for( int shift = 0; ; shift += 7 ) {
+               const auto b = byte();
+               result |= uint64_t( b & 0x7f ) << shift;
+               if( !( b & 0x80 ) ) return result;
+            }
+         }
+
+         void skip_s() {
+            while( byte() & 0x80 );
+         }
+
+         void skip( size_t size ) {
+            FC_ASSERT( size_t( end - pos ) >= size, "unexpected end of the wasm module" );
+            pos += size;
+         }
+
+         std::string name() {
+            const auto size = u();
+            const auto start = pos;
+            skip( size );
+            return std::string( reinterpret_cast<const char*>( start ), size );
+         }
+
+         // skips a constant expression, up to and including its `end`
+         void skip_init_expr() {
+            switch( byte() ) {
+               case 0x41: case 0x42: skip_s(); break; // i32.const, i64.const
+               case 0x43: skip( 4 ); break;           // f32.const
+               case 0x44: skip( 8 ); break;           // f64.const
+               case 0x23: u(); break;                 // global.get
+               default: FC_THROW( "unsupported constant expression" );
+            }
+            FC_ASSERT( byte() == 0x0b, "unsupported constant expression" );
+         }
+
+         void skip_limits() {
+            const auto flags = byte();
+            u();
+            if( flags & 1 ) u();
+         }
+      };
+
+      inline void put_u( std::vector<uint8_t>& out, uint64_t value ) {
+         do {
+            uint8_t b = value & 0x7f;
+            value >>= 7;
+            out.push_back( value ? b | 0x80 : b );
+         } while( value );
+      }
+
+      inline void put_s( std::vector<uint8_t>& out, int64_t value ) {
+         for( bool more = true; more; ) {
+            uint8_t b = value & 0x7f;
+            value >>= 7;
+            more = !( ( value == 0 && !( b & 0x40 ) ) || ( value == -1 && ( b & 0x40 ) ) );
+            out.push_back( more ? b | 0x80 : b );
+         }
+      }
+
+      inline void put_name( std::vector<uint8_t>& out, const std::string& name ) {
+         put_u( out, name.size() );
+         out.insert( out.end(), name.begin(), name.end() );
+      }
+
+      inline void put_section( std::vector<uint8_t>& out, uint8_t id, const std::vector<uint8_t>& content ) {
+         out.push_back( id );
+         put_u( out, content.size() );
+         out.insert( out.end(), content.begin(), content.end() );
+      }
+
+      inline void append( std::vector<uint8_t>& out, const uint8_t* begin, const uint8_t* end ) {
+         out.insert( out.end(), begin, end );
+      }
+
+      struct func_type {
+         std::vector<uint8_t> params;
+         std::vector<uint8_t> results;
+
+         bool operator==( const func_type& other )const {
+            return params == other.params && results == other.results;
+         }
+      };
+
+      /// Copies a function body, adding the instruction count of each straight-line run to global `counter` at its
+      /// start and renumbering the called functions with `remap`.
+      template<typename Remap>
+      std::vector<uint8_t> instrument_body( reader& r, uint32_t counter, const Remap& remap ) {
+         std::vector<uint8_t> out, run;
+         uint32_t count = 0;
+         const auto flush = [&] {
+            if( count > 0 ) {
+               out.push_back( 0x23 ); put_u( out, counter ); // global.get
+               out.push_back( 0x41 ); put_s( out, count );   // i32.const
+               out.push_back( 0x6a );                        // i32.add
+               out.push_back( 0x24 ); put_u( out, counter ); // global.set
+            }
+            out.insert( out.end(), run.begin(), run.end() );
+            run.clear();
+            count = 0;
+         };
+
+         // the locals are copied as they are
+         const auto locals_start = r.pos;
+         for( auto groups = r.u(); groups > 0; --groups ) {
+            r.u();
+            r.byte();
+         }
+         append( out, locals_start, r.pos );
+
+         for( int depth = 0; ; ) {
+            const auto start = r.pos;
+            const auto op = r.byte();
+            ++count;
+            // a run ends where the control flow can enter or leave, unreachable code after a branch starts a new one
+            bool ends_run = false;
+            switch( op ) {
+               case 0x02: case 0x03: case 0x04: { // block, loop, if
+                  const auto type = *r.pos;
+                  if( type == 0x40 || ( type >= 0x7b && type <= 0x7f ) ) r.byte();
+                  else r.skip_s();
+                  ++depth;
+                  ends_run = true;
+                  break;
+               }
+               case 0x05: ends_run = true; break; // else
+               case 0x0b:                         // end
+                  if( depth-- == 0 ) {
+                     append( run, start, r.pos );
+                     flush();
+                     return out;
+                  }
+                  ends_run = true;
+                  break;
+               case 0x0c: case 0x0d: r.u(); ends_run = true; break; // br, br_if
+               case 0x0e:                                           // br_table
+                  for( auto targets = r.u(); targets > 0; --targets ) r.u();
+                  r.u();
+                  ends_run = true;
+                  break;
+               case 0x00: case 0x0f: ends_run = true; break; // unreachable, return
+               case 0x10:                                    // call
+                  run.push_back( op );
+                  put_u( run, remap( r.u() ) );
+                  continue;
+               case 0x11: r.u(); r.byte(); break;                   // call_indirect
+               case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: r.u(); break; // local and global access
+               case 0x3f: case 0x40: r.byte(); break;               // memory.size, memory.grow
+               case 0x41: case 0x42: r.skip_s(); break;             // i32.const, i64.const
+               case 0x43: r.skip( 4 ); break;                       // f32.const
+               case 0x44: r.skip( 8 ); break;                       // f64.const
+               case 0xfc: FC_ASSERT( r.u() <= 7, "unsupported 0xfc instruction" ); break; // saturating truncations
+               default:
+                  if( op >= 0x28 && op <= 0x3e ) { // loads and stores
+                     r.u();
+                     r.u();
+                  } else {
+                     FC_ASSERT( op == 0x01 || op == 0x1a || op == 0x1b || ( op >= 0x45 && op <= 0xc4 ),
+                                "unsupported opcode ${op}", ("op", op) );
+                  }
+            }
+            append( run, start, r.pos );
+            if( ends_run ) flush();
+         }
+      }
+
+   } /// namespace detail
+
+   inline instrumented instrument( const std::vector<uint8_t>& wasm, const std::string& focus = {},
+                                   const std::vector<std::string>& hosts = {} ) {
+      using namespace detail;
+      static const uint8_t header[] = { 0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00 };
+      FC_ASSERT( wasm.size() >= sizeof(header) && std::equal( std::begin( header ), std::end( header ), wasm.begin() ),
+                 "not a wasm module" );
+
+      struct section {
+         uint8_t              id;
+         std::string          custom_name;
+         const uint8_t*       begin;
+         const uint8_t*       end;
+      };
+      std::vector<section> sections;
+      for( reader r{ wasm.data() + sizeof(header), wasm.data() + wasm.size() }; !r.done(); ) {
+         section s;
+         s.id = r.byte();
+         const auto size = r.u();
+         s.begin = r.pos;
+         r.skip( size );
+         s.end = r.pos;
+         if( s.id == 0 ) {
+            reader custom{ s.begin, s.end };
+            s.custom_name = custom.name();
+            s.begin = custom.pos;
+         }
+         sections.push_back( s );
+      }
+      const auto find = [&]( uint8_t id ) -> const section* {
+         for( const auto& s : sections ) if( s.id == id ) return &s;
+         return nullptr;
+      };
+
+      std::vector<func_type> types;
+      if( const auto* s = find( 1 ) ) {
+         reader r{ s->begin, s->end };
+         for( auto n = r.u(); n > 0; --n ) {
+            FC_ASSERT( r.byte() == 0x60, "unsupported function type" );
+            func_type type;
+            for( auto k = r.u(); k > 0; --k ) type.params.push_back( r.byte() );
+            for( auto k = r.u(); k > 0; --k ) type.results.push_back( r.byte() );
+            types.push_back( type );
+         }
+      }
+      const auto type_index = [&]( const func_type& type ) {
+         const auto it = std::find( types.begin(), types.end(), type );
+         if( it != types.end() ) return uint32_t( it - types.begin() );
+         types.push_back( type );
+         return uint32_t( types.size() - 1 );
+      };
+
+      // imports, `printhex` is added after the imported functions when the contract does not import it
+      uint32_t imported_funcs = 0, imported_globals = 0, import_count = 0;
+      std::optional<uint32_t> printhex;
+      std::map<std::string, std::pair<uint32_t, uint32_t>> env_funcs; // field, index and type
+      bool has_memory = find( 5 ) != nullptr;
+      std::vector<uint8_t> imports;
+      if( const auto* s = find( 2 ) ) {
+         reader r{ s->begin, s->end };
+         for( auto n = r.u(); n > 0; --n, ++import_count ) {
+            const auto start = r.pos;
+            const auto module = r.name();
+            const auto field = r.name();
+            switch( r.byte() ) {
+               case 0x00: {
+                  const auto type = r.u();
+                  if( module == "env" ) env_funcs[field] = { imported_funcs, type };
+                  if( module == "env" && field == "printhex" ) printhex = imported_funcs;
+                  ++imported_funcs;
+                  break;
+               }
+               case 0x01: r.byte(); r.skip_limits(); break;
+               case 0x02: r.skip_limits(); has_memory = true; break;
+               case 0x03: r.byte(); r.byte(); ++imported_globals; break;
+               default: FC_THROW( "unsupported import" );
+            }
+            append( imports, start, r.pos );
+         }
+      }
+      FC_ASSERT( has_memory, "the contract has no linear memory to print the counters from" );
+      const uint32_t shift = printhex ? 0 : 1;
+      if( !printhex ) {
+         put_name( imports, "env" );
+         put_name( imports, "printhex" );
+         imports.push_back( 0x00 );
+         put_u( imports, type_index( { { 0x7f, 0x7f }, {} } ) );
+         printhex = imported_funcs;
+         ++import_count;
+      }
+      const auto remap = [&]( uint64_t index ) { return index < imported_funcs ? index : index + shift; };
+
+      std::vector<uint32_t> func_types;
+      if( const auto* s = find( 3 ) ) {
+         reader r{ s->begin, s->end };
+         for( auto n = r.u(); n > 0; --n ) func_types.push_back( r.u() );
+      }
+      const uint32_t defined = func_types.size();
+
+      // mutable globals already used, the counters take the rest of the allowance
+      uint32_t defined_globals = 0, mutable_bytes = 0;
+      std::vector<uint8_t> globals;
+      if( const auto* s = find( 6 ) ) {
+         reader r{ s->begin, s->end };
+         for( auto n = r.u(); n > 0; --n, ++defined_globals ) {
+            const auto start = r.pos;
+            const auto type = r.byte();
+            if( r.byte() ) mutable_bytes += ( type == 0x7e || type == 0x7c ) ? 8 : 4;
+            r.skip_init_expr();
+            append( globals, start, r.pos );
+         }
+      }
+      const uint32_t first_counter = imported_globals + defined_globals;
+      const uint32_t budget = ( max_mutable_global_bytes - std::min( mutable_bytes, max_mutable_global_bytes ) ) / 4;
+
+      // the accounted host functions, which the contract imports, each take two counters
+      struct host {
+         std::string name;
+         uint32_t    index;
+         uint32_t    type;
+      };
+      std::vector<host> accounted;
+      for( const auto& name : hosts ) {
+         const auto it = env_funcs.find( name );
+         if( it != env_funcs.end() ) accounted.push_back( { name, it->second.first, it->second.second } );
+      }
+      FC_ASSERT( budget >= 2 + 2 * accounted.size(), "no mutable globals left for the counters" );
+      const uint32_t function_budget = budget - 2 * accounted.size();
+
+      std::map<uint64_t, std::string> names;
+      const section* name_section = nullptr;
+      for( const auto& s : sections ) {
+         if( s.id != 0 || s.custom_name != "name" ) continue;
+         name_section = &s;
+         for( reader r{ s.begin, s.end }; !r.done(); ) {
+            const auto id = r.byte();
+            const auto size = r.u();
+            reader sub{ r.pos, r.pos + size };
+            r.skip( size );
+            if( id != 1 ) continue;
+            for( auto n = sub.u(); n > 0; --n ) {
+               const auto index = sub.u();
+               names[index] = sub.name();
+            }
+         }
+      }
+
+      std::vector<const uint8_t*> bodies;
+      std::vector<size_t> body_sizes;
+      const auto* code = find( 10 );
+      FC_ASSERT( code, "the contract has no code" );
+      {
+         reader r{ code->begin, code->end };
+         for( auto n = r.u(); n > 0; --n ) {
+            const auto size = r.u();
+            bodies.push_back( r.pos );
+            body_sizes.push_back( size );
+            r.skip( size );
+         }
+      }
+      FC_ASSERT( bodies.size() == defined, "function and code sections disagree" );
+
+      // every function gets a counter if they fit, otherwise the focused then the largest ones
+      std::vector<uint32_t> counter_of( defined );
+      instrumented result;
+      std::vector<uint32_t> order( defined );
+      for( uint32_t i = 0; i < defined; ++i ) order[i] = i;
+      const bool shared = defined > function_budget;
+      if( shared ) {
+         const auto focused = [&]( uint32_t i ) {
+            const auto it = names.find( imported_funcs + i );
+            return !focus.empty() && it != names.end() && it->second.find( focus ) != std::string::npos;
+         };
+         std::stable_sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) {
+            if( focused( a ) != focused( b ) ) return focused( a );
+            return body_sizes[a] > body_sizes[b];
+         } );
+      }
+      const uint32_t own_counters = shared ? function_budget - 1 : defined;
+      std::set<std::string> used_names;
+      for( uint32_t k = 0; k < defined; ++k ) {
+         const auto i = order[k];
+         if( k >= own_counters ) {
+            counter_of[i] = own_counters;
+            continue;
+         }
+         counter_of[i] = k;
+         const auto it = names.find( imported_funcs + i );
+         auto name = it != names.end() ? it->second : "f" + std::to_string( imported_funcs + i );
+         if( !used_names.insert( name ).second ) name += "#" + std::to_string( imported_funcs + i );
+         result.counters.push_back( name );
+      }
+      if( shared ) result.counters.push_back( "(other)" );
+      for( const auto& h : accounted ) result.hosts.push_back( h.name );
+      const uint32_t counters = result.printed();
+
+      for( uint32_t k = 0; k < counters; ++k ) {
+         globals.push_back( 0x7f ); // i32
+         globals.push_back( 0x01 ); // mutable
+         globals.push_back( 0x41 ); // i32.const 0
+         globals.push_back( 0x00 );
+         globals.push_back( 0x0b );
+      }
+
+      // exports, `apply` points to its profiled wrapper, appended after the defined functions and followed by the
+      // stubs of the accounted host functions
+      const uint32_t wrapper = imported_funcs + shift + defined;
+      const auto call_target = [&]( uint64_t index ) -> uint64_t {
+         for( uint32_t h = 0; h < accounted.size(); ++h ) {
+            if( accounted[h].index == index ) return wrapper + 1 + h;
+         }
+         return remap( index );
+      };
+      std::optional<uint32_t> apply;
+      std::vector<uint8_t> exports;
+      uint32_t export_count = 0;
+      if( const auto* s = find( 7 ) ) {
+         reader r{ s->begin, s->end };
+         for( auto n = r.u(); n > 0; --n, ++export_count ) {
+            const auto name = r.name();
+            const auto kind = r.byte();
+            auto index = r.u();
+            if( kind == 0x00 ) {
+               if( name == "apply" ) {
+                  apply = index;
+                  index = wrapper;
+               } else {
+                  index = remap( index );
+               }
+            }
+            put_name( exports, name );
+            exports.push_back( kind );
+            put_u( exports, index );
+         }
+      }
+      FC_ASSERT( apply && *apply >= imported_funcs, "the contract does not export apply" );
+      const auto& apply_type = types.at( func_types.at( *apply - imported_funcs ) );
+
+      std::vector<uint8_t> wrapper_body;
+      put_u( wrapper_body, 0 ); // no locals
+      for( uint32_t p = 0; p < apply_type.params.size(); ++p ) {
+         wrapper_body.push_back( 0x20 ); // local.get
+         put_u( wrapper_body, p );
+      }
+      wrapper_body.push_back( 0x10 ); // call
+      put_u( wrapper_body, remap( *apply ) );
+      for( uint32_t i = 0; i < magic_size; ++i ) {
+         wrapper_body.push_back( 0x41 ); put_s( wrapper_body, i );
+         wrapper_body.push_back( 0x41 ); put_s( wrapper_body, magic[i] );
+         wrapper_body.push_back( 0x3a ); put_u( wrapper_body, 0 ); put_u( wrapper_body, 0 ); // i32.store8
+      }
+      for( uint32_t k = 0; k < counters; ++k ) {
+         wrapper_body.push_back( 0x41 ); put_s( wrapper_body, magic_size + 4 * k );
+         wrapper_body.push_back( 0x23 ); put_u( wrapper_body, first_counter + k );
+         wrapper_body.push_back( 0x36 ); put_u( wrapper_body, 2 ); put_u( wrapper_body, 0 ); // i32.store
+      }
+      wrapper_body.push_back( 0x41 ); put_s( wrapper_body, 0 );
+      wrapper_body.push_back( 0x41 ); put_s( wrapper_body, magic_size + 4 * counters );
+      wrapper_body.push_back( 0x10 ); put_u( wrapper_body, *printhex );
+      wrapper_body.push_back( 0x0b );
+
+      std::vector<uint8_t> code_out;
+      put_u( code_out, defined + 1 + accounted.size() );
+      for( uint32_t i = 0; i < defined; ++i ) {
+         reader r{ bodies[i], bodies[i] + body_sizes[i] };
+         const auto body = instrument_body( r, first_counter + counter_of[i], call_target );
+         put_u( code_out, body.size() );
+         code_out.insert( code_out.end(), body.begin(), body.end() );
+      }
+      put_u( code_out, wrapper_body.size() );
+      code_out.insert( code_out.end(), wrapper_body.begin(), wrapper_body.end() );
+
+      // each stub counts the call and the row bytes, then passes its parameters to the host and returns its result
+      for( uint32_t h = 0; h < accounted.size(); ++h ) {
+         const uint32_t calls = first_counter + counters - 2 * ( accounted.size() - h );
+         std::vector<uint8_t> stub;
+         put_u( stub, 0 ); // no locals
+         stub.push_back( 0x23 ); put_u( stub, calls );
+         stub.push_back( 0x41 ); put_s( stub, 1 );
+         stub.push_back( 0x6a );
+         stub.push_back( 0x24 ); put_u( stub, calls );
+         const auto length = row_length_params().find( accounted[h].name );
+         if( length != row_length_params().end() ) {
+            stub.push_back( 0x23 ); put_u( stub, calls + 1 );
+            stub.push_back( 0x20 ); put_u( stub, length->second );
+            stub.push_back( 0x6a );
+            stub.push_back( 0x24 ); put_u( stub, calls + 1 );
+         }
+         for( uint32_t p = 0; p < types.at( accounted[h].type ).params.size(); ++p ) {
+            stub.push_back( 0x20 );
+            put_u( stub, p );
+         }
+         stub.push_back( 0x10 ); put_u( stub, accounted[h].index );
+         stub.push_back( 0x0b );
+         put_u( code_out, stub.size() );
+         code_out.insert( code_out.end(), stub.begin(), stub.end() );
+      }
+
+      std::vector<uint8_t> functions_out;
+      put_u( functions_out, defined + 1 + accounted.size() );
+      for( auto type : func_types ) put_u( functions_out, type );
+      put_u( functions_out, type_index( apply_type ) );
+      for( const auto& h : accounted ) put_u( functions_out, h.type );
+
+      // the types last, since the sections above may have added some
+      std::vector<uint8_t> types_out;
+      put_u( types_out, types.size() );
+      for( const auto& type : types ) {
+         types_out.push_back( 0x60 );
+         put_u( types_out, type.params.size() );
+         types_out.insert( types_out.end(), type.params.begin(), type.params.end() );
+         put_u( types_out, type.results.size() );
+         types_out.insert( types_out.end(), type.results.begin(), type.results.end() );
+      }
+
+      const auto with_count = []( uint32_t count, const std::vector<uint8_t>& entries ) {
+         std::vector<uint8_t> out;
+         put_u( out, count );
+         out.insert( out.end(), entries.begin(), entries.end() );
+         return out;
+      };
+
+      std::map<uint8_t, std::vector<uint8_t>> rewritten;
+      rewritten[1]  = types_out;
+      rewritten[2]  = with_count( import_count, imports );
+      rewritten[3]  = functions_out;
+      rewritten[6]  = with_count( defined_globals + counters, globals );
+      rewritten[7]  = with_count( export_count, exports );
+      rewritten[10] = code_out;
+      if( const auto* s = find( 8 ) ) {
+         reader r{ s->begin, s->end };
+         std::vector<uint8_t> start;
+         put_u( start, remap( r.u() ) );
+         rewritten[8] = start;
+      }
+      if( const auto* s = find( 9 ) ) {
+         reader r{ s->begin, s->end };
+         std::vector<uint8_t> elements;
+         const auto n = r.u();
+         put_u( elements, n );
+         for( auto e = n; e > 0; --e ) {
+            const auto start = r.pos;
+            FC_ASSERT( r.u() == 0, "unsupported element segment" );
+            r.skip_init_expr();
+            append( elements, start, r.pos );
+            const auto count = r.u();
+            put_u( elements, count );
+            for( auto k = count; k > 0; --k ) put_u( elements, remap( r.u() ) );
+         }
+         rewritten[9] = elements;
+      }
+
+      std::vector<uint8_t> names_out;
+      if( name_section ) {
+         for( reader r{ name_section->begin, name_section->end }; !r.done(); ) {
+            const auto id = r.byte();
+            const auto size = r.u();
+            reader sub{ r.pos, r.pos + size };
+            r.skip( size );
+            std::vector<uint8_t> content;
+            if( id == 1 ) {
+               const auto n = sub.u();
+               put_u( content, n + 1 + accounted.size() );
+               for( auto k = n; k > 0; --k ) {
+                  put_u( content, remap( sub.u() ) );
+                  put_name( content, sub.name() );
+               }
+               put_u( content, wrapper );
+               put_name( content, "apply (profiled)" );
+               for( uint32_t h = 0; h < accounted.size(); ++h ) {
+                  put_u( content, wrapper + 1 + h );
+                  put_name( content, accounted[h].name + " (accounted)" );
+               }
+            } else if( id == 2 ) {
+               const auto n = sub.u();
+               put_u( content, n );
+               for( auto k = n; k > 0; --k ) {
+                  put_u( content, remap( sub.u() ) );
+                  const auto start = sub.pos;
+                  for( auto locals = sub.u(); locals > 0; --locals ) {
+                     sub.u();
+                     sub.name();
+                  }
+                  append( content, start, sub.pos );
+               }
+            } else {
+               append( content, sub.pos, sub.end );
+            }
+            put_section( names_out, id, content );
+         }
+      }
+
+      // sections in their order, with the import and global sections added where the module had none
+      auto& out = result.wasm;
+      out.assign( std::begin( header ), std::end( header ) );
+      std::set<uint8_t> emitted;
+      const auto emit_missing = [&]( uint8_t before ) {
+         for( uint8_t id : { uint8_t( 2 ), uint8_t( 6 ) } ) {
+            if( id < before && !emitted.count( id ) && !find( id ) ) {
+               put_section( out, id, rewritten[id] );
+               emitted.insert( id );
+            }
+         }
+      };
+      for( const auto& s : sections ) {
+         if( s.id == 0 ) {
+            std::vector<uint8_t> content;
+            put_name( content, s.custom_name );
+            if( &s == name_section ) content.insert( content.end(), names_out.begin(), names_out.end() );
+            else append( content, s.begin, s.end );
+            put_section( out, 0, content );
+            continue;
+         }
+         emit_missing( s.id );
+         if( rewritten.count( s.id ) ) put_section( out, s.id, rewritten[s.id] );
+         else put_section( out, s.id, std::vector<uint8_t>( s.begin, s.end ) );
+         emitted.insert( s.id );
+      }
+      emit_missing( 12 );
+      return result;
+   }
+
+   /// The counters printed by an instrumented action, none if the action did not reach the end of `apply`.
+   inline std::optional<std::vector<uint32_t>> counts( const std::string& console, const instrumented& profiled ) {
+      const auto counters = profiled.printed();
+      std::string marker;
+      for( uint32_t i = 0; i < magic_size; ++i ) {
+         static const char digits[] = "0123456789abcdef";
+         marker += digits[ uint8_t( magic[i] ) >> 4 ];
+         marker += digits[ uint8_t( magic[i] ) & 0xf ];
+      }
+      const auto at = console.rfind( marker );
+      if( at == std::string::npos || console.size() < at + marker.size() + counters * 8 ) return {};
+
+      std::vector<uint32_t> result( counters );
+      for( size_t k = 0; k < counters; ++k ) {
+         // little-endian bytes, each as two hex digits
+         for( int b = 3; b >= 0; --b ) {
+            const auto byte = std::stoul( console.substr( at + marker.size() + k * 8 + b * 2, 2 ), nullptr, 16 );
+            result[k] = result[k] << 8 | byte;
+         }
+      }
+      return result;
+   }
+
+   /// The calls to each accounted host function and the row bytes they moved, from the counters of an action.
+   inline std::map<std::string, host_calls> host_usage( const instrumented& profiled, const std::vector<uint32_t>& counts ) {
+      std::map<std::string, host_calls> usage;
+      for( size_t h = 0; h < profiled.hosts.size(); ++h ) {
+         const auto k = profiled.counters.size() + 2 * h;
+         usage[profiled.hosts[h]] = { counts.at( k ), counts.at( k + 1 ) };
+      }
+      return usage;
+   }
+
+} /// namespace wasm_profile